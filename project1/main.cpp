@@ -5,10 +5,25 @@
 #include <iomanip>
 #include <chrono>
 #include <vector>
+#include <algorithm>
 #include <thread>
 #include <cstring>
 #include "sm4_vprold.h"
 #include"sm4_aesni.h"
+#include "sm4_vaes.h"
+#include "sm4_gfni.h"
+#include "sm4_bitslice.h"
+#include "sm4_engine.h"
+#include "sm4_keycache.h"
+#include "sm4_parallel.h"
+#include "sm4_cbc.h"
+#include "sm4_xts.h"
+#include "sm4_ccm.h"
+#include "sm4_gcm_stream.h"
+#include "sm4_gmac.h"
+#include "sm4_gcm.h"
+#include "sm4_ghash_table.h"
+#include "sm4_ghash.h"
 #include "sm4_gcm_opt.h" 
 #include"sm4_gcm_simd.h"
 
@@ -22,79 +37,30 @@ void printBlock(const uint8_t block[16]) {
 void encryptDecryptOrigSingle(sm4& cipher, const std::vector<uint8_t>& in, std::vector<uint8_t>& out) {
     size_t numBlocks = in.size() / 16;
     std::vector<uint8_t> tmp(in.size());
-    for (size_t i = 0; i < numBlocks; ++i) {
-        cipher.encryptBlock(&in[i * 16], &tmp[i * 16]);
-    }
-    for (size_t i = 0; i < numBlocks; ++i) {
-        cipher.decryptBlock(&tmp[i * 16], &out[i * 16]);
-    }
+    cipher.encryptBlocks(in.data(), tmp.data(), numBlocks);
+    cipher.decryptBlocks(tmp.data(), out.data(), numBlocks);
 }
 
 void encryptDecryptTableSingle(sm4_table& cipher, const std::vector<uint8_t>& in, std::vector<uint8_t>& out) {
     size_t numBlocks = in.size() / 16;
     std::vector<uint8_t> tmp(in.size());
-    for (size_t i = 0; i < numBlocks; ++i) {
-        cipher.encryptBlock(&in[i * 16], &tmp[i * 16]);
-    }
-    for (size_t i = 0; i < numBlocks; ++i) {
-        cipher.decryptBlock(&tmp[i * 16], &out[i * 16]);
-    }
+    cipher.encryptBlocks(in.data(), tmp.data(), numBlocks);
+    cipher.decryptBlocks(tmp.data(), out.data(), numBlocks);
 }
 
-void encryptDecryptOrigMulti(sm4& cipher, const std::vector<uint8_t>& in, std::vector<uint8_t>& out, size_t numThreads) {
+// ̰߳汾̳߳سפ16 KiBĿзֲ֧ȡÿδ߳
+void encryptDecryptOrigMulti(sm4& cipher, const std::vector<uint8_t>& in, std::vector<uint8_t>& out, sm4_thread_pool& pool) {
     size_t numBlocks = in.size() / 16;
-    size_t blocksPerThread = numBlocks / numThreads;
     std::vector<uint8_t> tmp(in.size());
-    std::vector<std::thread> threads;
-
-    for (size_t t = 0; t < numThreads; ++t) {
-        size_t start = t * blocksPerThread;
-        size_t end = (t == numThreads - 1) ? numBlocks : start + blocksPerThread;
-        threads.emplace_back([&cipher, &in, &tmp, start, end]() {
-            for (size_t i = start; i < end; ++i)
-                cipher.encryptBlock(&in[i * 16], &tmp[i * 16]);
-            });
-    }
-    for (auto& th : threads) th.join();
-
-    threads.clear();
-    for (size_t t = 0; t < numThreads; ++t) {
-        size_t start = t * blocksPerThread;
-        size_t end = (t == numThreads - 1) ? numBlocks : start + blocksPerThread;
-        threads.emplace_back([&cipher, &tmp, &out, start, end]() {
-            for (size_t i = start; i < end; ++i)
-                cipher.decryptBlock(&tmp[i * 16], &out[i * 16]);
-            });
-    }
-    for (auto& th : threads) th.join();
+    parallel_encrypt_ecb(cipher, in.data(), tmp.data(), numBlocks, pool);
+    parallel_decrypt_ecb(cipher, tmp.data(), out.data(), numBlocks, pool);
 }
 
-void encryptDecryptTableMulti(sm4_table& cipher, const std::vector<uint8_t>& in, std::vector<uint8_t>& out, size_t numThreads) {
+void encryptDecryptTableMulti(sm4_table& cipher, const std::vector<uint8_t>& in, std::vector<uint8_t>& out, sm4_thread_pool& pool) {
     size_t numBlocks = in.size() / 16;
-    size_t blocksPerThread = numBlocks / numThreads;
     std::vector<uint8_t> tmp(in.size());
-    std::vector<std::thread> threads;
-
-    for (size_t t = 0; t < numThreads; ++t) {
-        size_t start = t * blocksPerThread;
-        size_t end = (t == numThreads - 1) ? numBlocks : start + blocksPerThread;
-        threads.emplace_back([&cipher, &in, &tmp, start, end]() {
-            for (size_t i = start; i < end; ++i)
-                cipher.encryptBlock(&in[i * 16], &tmp[i * 16]);
-            });
-    }
-    for (auto& th : threads) th.join();
-
-    threads.clear();
-    for (size_t t = 0; t < numThreads; ++t) {
-        size_t start = t * blocksPerThread;
-        size_t end = (t == numThreads - 1) ? numBlocks : start + blocksPerThread;
-        threads.emplace_back([&cipher, &tmp, &out, start, end]() {
-            for (size_t i = start; i < end; ++i)
-                cipher.decryptBlock(&tmp[i * 16], &out[i * 16]);
-            });
-    }
-    for (auto& th : threads) th.join();
+    parallel_encrypt_ecb(cipher, in.data(), tmp.data(), numBlocks, pool);
+    parallel_decrypt_ecb(cipher, tmp.data(), out.data(), numBlocks, pool);
 }
 
 // AESNIԺ
@@ -110,14 +76,68 @@ void encryptDecryptAESNI(sm4_aesni& cipher, const std::vector<uint8_t>& in, std:
         cipher.decryptBlocks8(&tmp[i * 8 * 16], &out[i * 8 * 16]);
     }
 
-    // ʣ಻8飬Լͨ麯ߺ
+    // ʣ಻8Ĳֽͨõ encryptBlocksּأ䣩
     size_t remainder = numBlocks % 8;
     size_t offset = numBlocks8 * 8 * 16;
-    for (size_t i = 0; i < remainder; ++i) {
-        // ԭʼӽ䣨ԼʵֵAESNI
-        cipher.encryptBlock(&in[offset + i * 16], &tmp[offset + i * 16]);
-        cipher.decryptBlock(&tmp[offset + i * 16], &out[offset + i * 16]);
+    cipher.encryptBlocks(&in[offset], &tmp[offset], remainder);
+    cipher.decryptBlocks(&tmp[offset], &out[offset], remainder);
+}
+
+// VAES 256λӽܣ16һ
+void encryptDecryptVAES(sm4_vaes& cipher, const std::vector<uint8_t>& in, std::vector<uint8_t>& out) {
+    size_t numBlocks = in.size() / 16;
+    size_t numBlocks16 = numBlocks / 16;
+    std::vector<uint8_t> tmp(in.size());
+
+    for (size_t i = 0; i < numBlocks16; ++i) {
+        cipher.encryptBlocks16(&in[i * 16 * 16], &tmp[i * 16 * 16]);
+    }
+    for (size_t i = 0; i < numBlocks16; ++i) {
+        cipher.decryptBlocks16(&tmp[i * 16 * 16], &out[i * 16 * 16]);
+    }
+
+    size_t remainder = numBlocks % 16;
+    size_t offset = numBlocks16 * 16 * 16;
+    cipher.encryptBlocks(&in[offset], &tmp[offset], remainder);
+    cipher.decryptBlocks(&tmp[offset], &out[offset], remainder);
+}
+
+// GFNI 512λӽܣ32һ
+void encryptDecryptGFNI(sm4_gfni& cipher, const std::vector<uint8_t>& in, std::vector<uint8_t>& out) {
+    size_t numBlocks = in.size() / 16;
+    size_t numBlocks32 = numBlocks / 32;
+    std::vector<uint8_t> tmp(in.size());
+
+    for (size_t i = 0; i < numBlocks32; ++i) {
+        cipher.encryptBlocks32(&in[i * 32 * 16], &tmp[i * 32 * 16]);
+    }
+    for (size_t i = 0; i < numBlocks32; ++i) {
+        cipher.decryptBlocks32(&tmp[i * 32 * 16], &out[i * 32 * 16]);
+    }
+
+    size_t remainder = numBlocks % 32;
+    size_t offset = numBlocks32 * 32 * 16;
+    cipher.encryptBlocks(&in[offset], &tmp[offset], remainder);
+    cipher.decryptBlocks(&tmp[offset], &out[offset], remainder);
+}
+
+// Ƭӽܣ256һ飨޲ʱ䣩
+void encryptDecryptBitslice(sm4_bitslice& cipher, const std::vector<uint8_t>& in, std::vector<uint8_t>& out) {
+    size_t numBlocks = in.size() / 16;
+    size_t numBlocks256 = numBlocks / 256;
+    std::vector<uint8_t> tmp(in.size());
+
+    for (size_t i = 0; i < numBlocks256; ++i) {
+        cipher.encryptBlocks256(&in[i * 256 * 16], &tmp[i * 256 * 16]);
+    }
+    for (size_t i = 0; i < numBlocks256; ++i) {
+        cipher.decryptBlocks256(&tmp[i * 256 * 16], &out[i * 256 * 16]);
     }
+
+    size_t remainder = numBlocks % 256;
+    size_t offset = numBlocks256 * 256 * 16;
+    cipher.encryptBlocks(&in[offset], &tmp[offset], remainder);
+    cipher.decryptBlocks(&tmp[offset], &out[offset], remainder);
 }
 
 // gcm test
@@ -197,6 +217,7 @@ int main() {
     
     sm4 cipher_orig;
     sm4_table cipher_table;
+    sm4_thread_pool pool(NUM_THREADS);
     cipher_orig.setKey(key);
     cipher_table.setKey(key);
 
@@ -207,10 +228,10 @@ int main() {
     encryptDecryptTableSingle(cipher_table, input, out_table_s);
     auto t3 = std::chrono::high_resolution_clock::now();
 
-    encryptDecryptOrigMulti(cipher_orig, input, out_orig_mt, NUM_THREADS);
+    encryptDecryptOrigMulti(cipher_orig, input, out_orig_mt, pool);
     auto t4 = std::chrono::high_resolution_clock::now();
 
-    encryptDecryptTableMulti(cipher_table, input, out_table_mt, NUM_THREADS);
+    encryptDecryptTableMulti(cipher_table, input, out_table_mt, pool);
     auto t5 = std::chrono::high_resolution_clock::now();
 
     std::cout << "ԭʼ߳ʱ: " << std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count() << " ms\n";
@@ -233,13 +254,285 @@ int main() {
     // ̼߳ӽ
     size_t numBlocks = input.size() / 16;
     std::vector<uint8_t> tmp_vprold(input.size());
-    for (size_t i = 0; i < numBlocks; ++i)
-        cipher_vprold.encryptBlock(&input[i * 16], &tmp_vprold[i * 16]);
-    for (size_t i = 0; i < numBlocks; ++i)
-        cipher_vprold.decryptBlock(&tmp_vprold[i * 16], &out_vprold[i * 16]);
+    cipher_vprold.encryptBlocks(input.data(), tmp_vprold.data(), numBlocks);
+    cipher_vprold.decryptBlocks(tmp_vprold.data(), out_vprold.data(), numBlocks);
     auto t_vprold_end = std::chrono::high_resolution_clock::now();
     std::cout << "VPROLD ֤: " << (input == out_vprold ? "ȷ" : "") << "\n";
 
+    // 1 KiB棺T1..T3  T0 ѭλõ
+    sm4_table_compact cipher_compact;
+    cipher_compact.setKey(key);
+    std::vector<uint8_t> tmp_compact(input.size()), out_compact(input.size());
+    auto t_compact_start = std::chrono::high_resolution_clock::now();
+    cipher_compact.encryptBlocks(input.data(), tmp_compact.data(), numBlocks);
+    cipher_compact.decryptBlocks(tmp_compact.data(), out_compact.data(), numBlocks);
+    auto t_compact_end = std::chrono::high_resolution_clock::now();
+    std::cout << "(1 KiB)߳ʱ: " << std::chrono::duration_cast<std::chrono::milliseconds>(t_compact_end - t_compact_start).count() << " ms\n";
+    std::cout << "֤: " << (input == out_compact ? "ȷ" : "") << "\n";
+
+    sm4_vaes cipher_vaes;
+    cipher_vaes.setKey(key);
+    std::vector<uint8_t> out_vaes(input.size());
+
+    auto t_vaes_start = std::chrono::high_resolution_clock::now();
+    encryptDecryptVAES(cipher_vaes, input, out_vaes);
+    auto t_vaes_end = std::chrono::high_resolution_clock::now();
+    std::cout << "VAES ӽʱ: " << std::chrono::duration_cast<std::chrono::milliseconds>(t_vaes_end - t_vaes_start).count() << " ms\n";
+    std::cout << "VAES ֤: " << (input == out_vaes ? "ȷ" : "") << "\n";
+
+    // Կͨ֯ÿỰֻ2飬ͬỰķ鹲ͨ
+    {
+        const size_t numSessions = 4096;
+        std::vector<uint32_t> sessionRk(numSessions * 32);
+        std::vector<const uint32_t*> rks(numSessions * 2);
+        for (size_t s = 0; s < numSessions; ++s) {
+            uint8_t sessionKey[16];
+            for (int i = 0; i < 16; ++i)
+                sessionKey[i] = static_cast<uint8_t>(key[i] ^ (s >> (i % 2 * 8)));
+            sm4::expandKey(sessionKey, &sessionRk[s * 32]);
+            rks[2 * s] = rks[2 * s + 1] = &sessionRk[s * 32];
+        }
+        std::vector<uint8_t> mkIn(input.begin(), input.begin() + numSessions * 32);
+        std::vector<uint8_t> mkTmp(mkIn.size()), mkOut(mkIn.size());
+
+        auto t_mk_start = std::chrono::high_resolution_clock::now();
+        sm4_vaes::encryptBlocksMultiKey(rks.data(), mkIn.data(), mkTmp.data(), rks.size());
+        sm4_vaes::decryptBlocksMultiKey(rks.data(), mkTmp.data(), mkOut.data(), rks.size());
+        auto t_mk_end = std::chrono::high_resolution_clock::now();
+
+        sm4 check;
+        uint8_t ref[16];
+        check.setKey(key);
+        check.encryptBlock(&mkIn[0], ref);  // Ự0Կ key
+        bool mkOk = mkOut == mkIn && std::memcmp(ref, &mkTmp[0], 16) == 0;
+        std::cout << "ԿVAES(" << numSessions << "Ự) ӽʱ: "
+            << std::chrono::duration_cast<std::chrono::microseconds>(t_mk_end - t_mk_start).count() << " us\n";
+        std::cout << "ԿVAES ֤: " << (mkOk ? "ȷ" : "") << "\n";
+
+        // Կչ8Կһͨͬʱţֱӵõ [32][8] ֯Կ
+        std::vector<uint8_t> sessionKeys(numSessions * 16);
+        for (size_t s = 0; s < numSessions; ++s)
+            for (int i = 0; i < 16; ++i)
+                sessionKeys[s * 16 + i] = static_cast<uint8_t>(key[i] ^ (s >> (i % 2 * 8)));
+        std::vector<uint32_t> scalarRk(numSessions * 32), laneRk(numSessions * 32);
+        auto t_ks_start = std::chrono::high_resolution_clock::now();
+        for (size_t s = 0; s < numSessions; ++s)
+            sm4::expandKey(&sessionKeys[s * 16], &scalarRk[s * 32]);
+        auto t_ks_mid = std::chrono::high_resolution_clock::now();
+        sm4_vaes::setKeys(reinterpret_cast<const uint8_t(*)[16]>(sessionKeys.data()), numSessions,
+            reinterpret_cast<uint32_t(*)[32][8]>(laneRk.data()));
+        auto t_ks_end = std::chrono::high_resolution_clock::now();
+
+        bool ksOk = true;
+        for (size_t s = 0; s < numSessions; ++s)
+            for (int r = 0; r < 32; ++r)
+                ksOk = ksOk && laneRk[(s / 8 * 32 + r) * 8 + s % 8] == scalarRk[s * 32 + r];
+        std::cout << "Կչ(" << numSessions << "Կ) : "
+            << std::chrono::duration_cast<std::chrono::microseconds>(t_ks_mid - t_ks_start).count() << " us, : "
+            << std::chrono::duration_cast<std::chrono::microseconds>(t_ks_end - t_ks_mid).count() << " us\n";
+        std::cout << "Կչ ֤: " << (ksOk ? "ȷ" : "") << "\n";
+    }
+
+    sm4_gfni cipher_gfni;
+    cipher_gfni.setKey(key);
+    std::vector<uint8_t> out_gfni(input.size());
+
+    auto t_gfni_start = std::chrono::high_resolution_clock::now();
+    encryptDecryptGFNI(cipher_gfni, input, out_gfni);
+    auto t_gfni_end = std::chrono::high_resolution_clock::now();
+    std::cout << "GFNI ӽʱ: " << std::chrono::duration_cast<std::chrono::milliseconds>(t_gfni_end - t_gfni_start).count() << " ms\n";
+    std::cout << "GFNI ֤: " << (input == out_gfni ? "ȷ" : "") << "\n";
+
+    sm4_bitslice cipher_bs;
+    cipher_bs.setKey(key);
+    std::vector<uint8_t> out_bs(input.size());
+
+    auto t_bs_start = std::chrono::high_resolution_clock::now();
+    encryptDecryptBitslice(cipher_bs, input, out_bs);
+    auto t_bs_end = std::chrono::high_resolution_clock::now();
+    std::cout << "Ƭӽʱ: " << std::chrono::duration_cast<std::chrono::milliseconds>(t_bs_end - t_bs_start).count() << " ms\n";
+    std::cout << "Ƭ֤: " << (input == out_bs ? "ȷ" : "") << "\n";
+
+    // һ²ܷ S е·Ĵ󣨼ӽͬһ·οʵֽڱȶԣ
+    // ׼ļԿԼ bs64/bs128/bs256 βĸֿ
+    static const uint8_t sm4_std_ct[16] = { 0x68,0x1e,0xdf,0x34,0xd2,0x06,0x96,0x5e,0x86,0xb3,0xe9,0x4f,0x53,0x6e,0x42,0x46 };
+    uint8_t bs_ct[16];
+    cipher_bs.encryptBlock(key, bs_ct);
+    bool bsRefOk = std::equal(bs_ct, bs_ct + 16, sm4_std_ct);
+    for (size_t n : { 1, 63, 64, 65, 127, 128, 129, 255, 256, 300, 700 }) {
+        std::vector<uint8_t> want(n * 16), got(n * 16);
+        cipher_orig.encryptBlocks(input.data(), want.data(), n);
+        cipher_bs.encryptBlocks(input.data(), got.data(), n);
+        bsRefOk = bsRefOk && got == want;
+        cipher_bs.decryptBlocks(want.data(), got.data(), n);
+        bsRefOk = bsRefOk && std::equal(got.begin(), got.end(), input.begin());
+    }
+    std::cout << "Ƭοʵֱȶ: " << (bsRefOk ? "ȷ" : "") << "\n";
+
+    // ʱCPUԶѡˣû SM4_ENGINE ǿָ
+    std::unique_ptr<sm4_engine> engine = sm4_engine::create();
+    engine->setKey(key);
+    std::vector<uint8_t> tmp_engine(input.size()), out_engine(input.size());
+
+    auto t_engine_start = std::chrono::high_resolution_clock::now();
+    engine->encryptBlocks(input.data(), tmp_engine.data(), numBlocks);
+    engine->decryptBlocks(tmp_engine.data(), out_engine.data(), numBlocks);
+    auto t_engine_end = std::chrono::high_resolution_clock::now();
+    std::cout << "sm4_engine : " << engine->name() << "\n";
+    std::cout << "sm4_engine ӽʱ: " << std::chrono::duration_cast<std::chrono::milliseconds>(t_engine_end - t_engine_start).count() << " ms\n";
+    std::cout << "sm4_engine ֤: " << (input == out_engine ? "ȷ" : "") << "\n";
+
+    // ̳߳ϵ CTR ģʽˣ sm4_engine ѡĺˣ
+    uint8_t ctr_iv[16] = { 0xf0,0xf1,0xf2,0xf3,0xf4,0xf5,0xf6,0xf7,0xf8,0xf9,0xfa,0xfb,0xfc,0xfd,0xfe,0xff };
+    std::vector<uint8_t> tmp_ctr(input.size()), out_ctr(input.size());
+    auto t_ctr_start = std::chrono::high_resolution_clock::now();
+    parallel_ctr(*engine, ctr_iv, input.data(), tmp_ctr.data(), input.size(), pool);
+    parallel_ctr(*engine, ctr_iv, tmp_ctr.data(), out_ctr.data(), input.size(), pool);
+    auto t_ctr_end = std::chrono::high_resolution_clock::now();
+    std::cout << "CTR ӽʱ: " << std::chrono::duration_cast<std::chrono::milliseconds>(t_ctr_end - t_ctr_start).count() << " ms\n";
+    std::cout << "CTR ֤: " << (input == out_ctr ? "ȷ" : "") << "\n";
+
+    // SM4-CBC߿ںˣܰѶ֯ͨ
+    {
+        sm4_cbc<sm4_gfni> cbc;
+        cbc.setKey(key);
+        uint8_t cbc_iv[16] = { 0 };
+        const size_t numStreams = 64, streamLen = input.size() / numStreams / 16 * 16;
+        std::vector<uint8_t> tmp_cbc(input.size()), out_cbc(input.size());
+        std::vector<const uint8_t*> ivs(numStreams, cbc_iv), ins(numStreams);
+        std::vector<uint8_t*> outs(numStreams);
+        std::vector<size_t> lens(numStreams, streamLen);
+        for (size_t s = 0; s < numStreams; ++s) {
+            ins[s] = &input[s * streamLen];
+            outs[s] = &tmp_cbc[s * streamLen];
+        }
+
+        auto t_cbc_start = std::chrono::high_resolution_clock::now();
+        cbc.encryptStreams(ivs.data(), ins.data(), outs.data(), lens.data(), numStreams);
+        auto t_cbc_mid = std::chrono::high_resolution_clock::now();
+        for (size_t s = 0; s < numStreams; ++s)
+            cbc.decrypt(cbc_iv, outs[s], &out_cbc[s * streamLen], streamLen);
+        auto t_cbc_end = std::chrono::high_resolution_clock::now();
+
+        // 0һ飬Ӧ뽻֯ܵĽͬ
+        std::vector<uint8_t> single(streamLen);
+        cbc.encrypt(cbc_iv, ins[0], single.data(), streamLen);
+        bool cbcOk = std::equal(input.begin(), input.begin() + numStreams * streamLen, out_cbc.begin()) &&
+            std::equal(single.begin(), single.end(), tmp_cbc.begin());
+        std::cout << "CBC " << numStreams << "·֯ʱ: " << std::chrono::duration_cast<std::chrono::microseconds>(t_cbc_mid - t_cbc_start).count() << " us, "
+            << "ʱ: " << std::chrono::duration_cast<std::chrono::microseconds>(t_cbc_end - t_cbc_mid).count() << " us\n";
+        std::cout << "CBC ֤: " << (cbcOk ? "ȷ" : "") << "\n";
+    }
+
+    // SM4-XTSӽܣ4 KiBΪtweakһ֪𰸲
+    {
+        static const uint8_t xts_key[32] = {
+            0x2b,0x7e,0x15,0x16,0x28,0xae,0xd2,0xa6,0xab,0xf7,0x15,0x88,0x09,0xcf,0x4f,0x3c,
+            0x00,0x01,0x02,0x03,0x04,0x05,0x06,0x07,0x08,0x09,0x0a,0x0b,0x0c,0x0d,0x0e,0x0f };
+        static const uint8_t xts_iv[16] = { 0xf0,0xf1,0xf2,0xf3,0xf4,0xf5,0xf6,0xf7,0xf8,0xf9,0xfa,0xfb,0xfc,0xfd,0xfe,0xff };
+        static const uint8_t xts_pt[56] = {
+            0x6b,0xc1,0xbe,0xe2,0x2e,0x40,0x9f,0x96,0xe9,0x3d,0x7e,0x11,0x73,0x93,0x17,0x2a,
+            0xae,0x2d,0x8a,0x57,0x1e,0x03,0xac,0x9c,0x9e,0xb7,0x6f,0xac,0x45,0xaf,0x8e,0x51,
+            0x30,0xc8,0x1c,0x46,0xa3,0x5c,0xe4,0x11,0xe5,0xfb,0xc1,0x19,0x1a,0x0a,0x52,0xef,
+            0xf6,0x9f,0x24,0x45,0xdf,0x4f,0x9b,0x17 };
+        static const uint8_t xts_ct[56] = {
+            0xe9,0x53,0x82,0x51,0xc7,0x1d,0x7b,0x80,0xbb,0xe4,0x48,0x3f,0xef,0x49,0x7b,0xd1,
+            0xb3,0xdb,0x1a,0x3e,0x60,0x40,0x8c,0x57,0x5d,0x63,0xff,0x7d,0xb3,0x9f,0x83,0x26,
+            0x08,0x69,0xf9,0xe2,0x58,0x5f,0xec,0x9f,0x0b,0x86,0x3b,0xf8,0xfd,0x78,0x4b,0x86,
+            0x27,0xd1,0x6c,0x0d,0xb6,0xd2,0xcf,0xc7 };
+        sm4_xts<sm4_gfni> xts;
+        xts.setKey(xts_key);
+        uint8_t kat[56];
+        xts.encrypt(xts_iv, xts_pt, kat, sizeof(kat));
+        bool xtsOk = std::equal(kat, kat + sizeof(kat), xts_ct);
+
+        const size_t sectorSize = 4096, numSectors = input.size() / sectorSize;
+        std::vector<uint8_t> tmp_xts(input.size()), out_xts(input.size());
+        auto t_xts_start = std::chrono::high_resolution_clock::now();
+        xts.encryptSectors((uint64_t)0, input.data(), tmp_xts.data(), sectorSize, numSectors);
+        auto t_xts_mid = std::chrono::high_resolution_clock::now();
+        xts.decryptSectors((uint64_t)0, tmp_xts.data(), out_xts.data(), sectorSize, numSectors);
+        auto t_xts_end = std::chrono::high_resolution_clock::now();
+        xtsOk = xtsOk && std::equal(input.begin(), input.begin() + numSectors * sectorSize, out_xts.begin());
+        std::cout << "XTS " << numSectors << "ʱ: " << std::chrono::duration_cast<std::chrono::microseconds>(t_xts_mid - t_xts_start).count() << " us, "
+            << "ʱ: " << std::chrono::duration_cast<std::chrono::microseconds>(t_xts_end - t_xts_mid).count() << " us\n";
+        std::cout << "XTS ֤: " << (xtsOk ? "ȷ" : "") << "\n";
+    }
+
+    // SM4-CCMCTR Կǰɣ CBC-MAC ں˵УRFC 8998 
+    {
+        static const uint8_t ccm_key[16] = { 0x01,0x23,0x45,0x67,0x89,0xab,0xcd,0xef,0xfe,0xdc,0xba,0x98,0x76,0x54,0x32,0x10 };
+        static const uint8_t ccm_iv[12] = { 0x00,0x00,0x12,0x34,0x56,0x78,0x00,0x00,0x00,0x00,0xab,0xcd };
+        static const uint8_t ccm_aad[20] = {
+            0xfe,0xed,0xfa,0xce,0xde,0xad,0xbe,0xef,0xfe,0xed,0xfa,0xce,0xde,0xad,0xbe,0xef,0xab,0xad,0xda,0xd2 };
+        static const uint8_t ccm_ct[64] = {
+            0x48,0xaf,0x93,0x50,0x1f,0xa6,0x2a,0xdb,0xcd,0x41,0x4c,0xce,0x60,0x34,0xd8,0x95,
+            0xdd,0xa1,0xbf,0x8f,0x13,0x2f,0x04,0x20,0x98,0x66,0x15,0x72,0xe7,0x48,0x30,0x94,
+            0xfd,0x12,0xe5,0x18,0xce,0x06,0x2c,0x98,0xac,0xee,0x28,0xd9,0x5d,0xf4,0x41,0x6b,
+            0xed,0x31,0xa2,0xf0,0x44,0x76,0xc1,0x8b,0xb4,0x0c,0x84,0xa7,0x4b,0x97,0xdc,0x5b };
+        static const uint8_t ccm_tag[16] = { 0x16,0x84,0x2d,0x4f,0xa1,0x86,0xf5,0x6a,0xb3,0x32,0x56,0x97,0x1f,0xa1,0x10,0xf4 };
+        uint8_t ccm_pt[64], kat[64], katTag[16], back[64];
+        const uint8_t fill[8] = { 0xaa,0xbb,0xcc,0xdd,0xee,0xff,0xee,0xaa };
+        for (int i = 0; i < 64; ++i)
+            ccm_pt[i] = fill[i / 8];
+
+        sm4_ccm<sm4_gfni> ccm;
+        ccm.setKey(ccm_key);
+        ccm.encrypt(ccm_iv, 12, ccm_pt, 64, ccm_aad, 20, kat, katTag);
+        bool ccmOk = std::equal(kat, kat + 64, ccm_ct) && std::equal(katTag, katTag + 16, ccm_tag) &&
+            ccm.decrypt(ccm_iv, 12, kat, 64, ccm_aad, 20, katTag, 16, back) && std::equal(back, back + 64, ccm_pt);
+
+        std::vector<uint8_t> tmp_ccm(input.size()), out_ccm(input.size());
+        uint8_t bulkTag[16];
+        auto t_ccm_start = std::chrono::high_resolution_clock::now();
+        ccm.encrypt(ccm_iv, 12, input.data(), input.size(), nullptr, 0, tmp_ccm.data(), bulkTag);
+        auto t_ccm_mid = std::chrono::high_resolution_clock::now();
+        ccmOk = ccmOk && ccm.decrypt(ccm_iv, 12, tmp_ccm.data(), tmp_ccm.size(), nullptr, 0, bulkTag, 16, out_ccm.data()) &&
+            input == out_ccm;
+        auto t_ccm_end = std::chrono::high_resolution_clock::now();
+        std::cout << "CCM ʱ: " << std::chrono::duration_cast<std::chrono::microseconds>(t_ccm_mid - t_ccm_start).count() << " us, "
+            << "ʱ: " << std::chrono::duration_cast<std::chrono::microseconds>(t_ccm_end - t_ccm_mid).count() << " us\n";
+        std::cout << "CCM ֤: " << (ccmOk ? "ȷ" : "") << "\n";
+    }
+
+    // չԿ棺ģ⻧ԿʹáÿֻһСϢ
+    {
+        const size_t numTenants = 1000, rounds = 20;
+        std::vector<uint8_t> tenantKeys(numTenants * 16);
+        for (size_t i = 0; i < tenantKeys.size(); ++i)
+            tenantKeys[i] = static_cast<uint8_t>((i / 16) >> (8 * (i % 4)) ^ (i * 131 + 7));
+        uint8_t civ[12] = { 0 }, msg[64] = { 0 }, cct[64], ctag[16], rtag[16];
+        bool same = true;
+
+        auto t_raw_start = std::chrono::high_resolution_clock::now();
+        for (size_t r = 0; r < rounds; ++r)
+            for (size_t t = 0; t < numTenants; ++t) {
+                sm4_gcm_simd g(&tenantKeys[t * 16], civ, 12);
+                g.encrypt(msg, 64, nullptr, 0, cct, rtag);
+            }
+        auto t_raw_end = std::chrono::high_resolution_clock::now();
+
+        sm4_key_cache cache(numTenants);
+        auto t_cache_start = std::chrono::high_resolution_clock::now();
+        for (size_t r = 0; r < rounds; ++r)
+            for (size_t t = 0; t < numTenants; ++t) {
+                std::shared_ptr<const sm4_expanded_key> xk = cache.get(&tenantKeys[t * 16]);
+                sm4_gcm_simd g(*xk, civ, 12);
+                g.encrypt(msg, 64, nullptr, 0, cct, ctag);
+            }
+        auto t_cache_end = std::chrono::high_resolution_clock::now();
+
+        sm4_gcm_simd last(&tenantKeys[(numTenants - 1) * 16], civ, 12);
+        last.encrypt(msg, 64, nullptr, 0, cct, rtag);
+        same = std::memcmp(rtag, ctag, 16) == 0;
+
+        sm4_key_cache::stats st = cache.counters();
+        std::cout << "Կ ÿչ: " << std::chrono::duration_cast<std::chrono::microseconds>(t_raw_end - t_raw_start).count() << " us, "
+            << "ʹû: " << std::chrono::duration_cast<std::chrono::microseconds>(t_cache_end - t_cache_start).count() << " us\n";
+        std::cout << "Կ /δ/̭: " << st.hits << "/" << st.misses << "/" << st.evictions
+            << ", ֤: " << (same ? "ȷ" : "") << "\n";
+    }
+
 
 
     // SM4-GCM 
@@ -290,6 +583,21 @@ int main() {
     std::cout << "sm4_gcm_opt ܺʱ: "
         << std::chrono::duration_cast<std::chrono::microseconds>(t_end_opt - t_start_opt).count()
         << " us\n";
+
+    // GHASH 4λ256ֽڣ8λ4 KiBݵĺʱͽԱ
+    {
+        std::vector<uint8_t> ct4(input.size()), ct8(input.size());
+        uint8_t tag4[16], tag8[16];
+        sm4_gcm_opt g4(key, iv, 12, 4), g8(key, iv, 12, 8);
+        auto t4_start = std::chrono::high_resolution_clock::now();
+        g4.encrypt(input.data(), input.size(), nullptr, 0, ct4.data(), tag4);
+        auto t8_start = std::chrono::high_resolution_clock::now();
+        g8.encrypt(input.data(), input.size(), nullptr, 0, ct8.data(), tag8);
+        auto t8_end = std::chrono::high_resolution_clock::now();
+        std::cout << "sm4_gcm_opt 4λ: " << std::chrono::duration_cast<std::chrono::milliseconds>(t8_start - t4_start).count()
+            << " ms, 8λ: " << std::chrono::duration_cast<std::chrono::milliseconds>(t8_end - t8_start).count() << " ms\n";
+        std::cout << "GHASH ֤: " << (ct4 == ct8 && std::equal(tag4, tag4 + 16, tag8) ? "ȷ" : "") << "\n";
+    }
     std::cout << "\n========== sm4_gcm_simd Ż ==========" << std::endl;
 
     // SIMD 汾
@@ -311,5 +619,271 @@ int main() {
         << std::chrono::duration_cast<std::chrono::microseconds>(t_end_simd - t_start_simd).count()
         << " us\n\n";
 
+    std::cout << "========== Կ seal/open  ==========" << std::endl;
+    {
+        // 1000  1 KiB ģÿһ nonceÿ½  һԿ󷴸 seal Ա
+        const size_t numPackets = 1000, pktLen = 1024;
+        std::vector<uint8_t> pkt(pktLen, 0x5a), ctNew(pktLen), ctSeal(pktLen), back(pktLen);
+        uint8_t nonce[12] = { 0 }, tagNew[16], tagSeal[16];
+        bool reuseOk = true;
+
+        auto t_new_start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < numPackets; ++i) {
+            std::memcpy(nonce, &i, sizeof(i));
+            sm4_gcm_simd g(key, nonce, 12);
+            g.encrypt(pkt.data(), pktLen, iv, 12, ctNew.data(), tagNew);
+        }
+        auto t_new_end = std::chrono::high_resolution_clock::now();
+
+        const sm4_gcm_simd sealer(key);
+        auto t_seal_start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < numPackets; ++i) {
+            std::memcpy(nonce, &i, sizeof(i));
+            sealer.seal(nonce, 12, pkt.data(), pktLen, iv, 12, ctSeal.data(), tagSeal);
+        }
+        auto t_seal_end = std::chrono::high_resolution_clock::now();
+        reuseOk = ctNew == ctSeal && std::equal(tagNew, tagNew + 16, tagSeal) &&
+            sealer.open(nonce, 12, ctSeal.data(), pktLen, iv, 12, tagSeal, back.data()) && back == pkt;
+
+        //  96 λ nonceʵֵ seal 밴 IV ľɽӿڽһ£ԭ open
+        const sm4gcm k1(key);
+        const sm4_gcm_opt k2(key);
+        uint8_t nonce8[8] = { 1, 2, 3, 4, 5, 6, 7, 8 }, t1[16], t2[16], t3[16], t4[16];
+        std::vector<uint8_t> c1(100), c2(100), c3(100), c4(100);
+        k1.seal(nonce8, 8, pkt.data(), 100, nullptr, 0, c1.data(), t1);
+        k2.seal(nonce8, 8, pkt.data(), 100, nullptr, 0, c2.data(), t2);
+        sealer.seal(nonce8, 8, pkt.data(), 100, nullptr, 0, c3.data(), t3);
+        sm4_gcm_simd(key, nonce8, 8).encrypt(pkt.data(), 100, nullptr, 0, c4.data(), t4);
+        reuseOk = reuseOk && c1 == c2 && c2 == c3 && c3 == c4 &&
+            std::equal(t1, t1 + 16, t2) && std::equal(t2, t2 + 16, t3) && std::equal(t3, t3 + 16, t4);
+        reuseOk = reuseOk && k1.open(nonce8, 8, c1.data(), 100, nullptr, 0, t1, c1.data()) &&
+            k2.open(nonce8, 8, c2.data(), 100, nullptr, 0, t2, c2.data()) &&
+            std::equal(c1.begin(), c1.end(), pkt.begin()) && std::equal(c2.begin(), c2.end(), pkt.begin());
+
+        std::cout << "1 KiB ÿ½: " << std::chrono::duration_cast<std::chrono::microseconds>(t_new_end - t_new_start).count()
+            << " us, Կ seal: " << std::chrono::duration_cast<std::chrono::microseconds>(t_seal_end - t_seal_start).count() << " us\n";
+        std::cout << "seal/open ֤: " << (reuseOk ? "ȷ" : "") << "\n\n";
+    }
+
+    std::cout << "========== С AEAD  ==========" << std::endl;
+    {
+        // 5000  64 ֽڼ¼ nonce/AAD/Tag seal  seal_batch Ա
+        const size_t numRecs = 5000, recLen = 64;
+        const sm4_gcm_simd g(key);
+        std::vector<uint8_t> nonces(numRecs * 12), ctOne(numRecs * recLen), ctBatch(numRecs * recLen);
+        std::vector<uint8_t> tagOne(numRecs * 16), tagBatch(numRecs * 16);
+        std::vector<sm4_gcm_record> recs(numRecs);
+        for (size_t i = 0; i < numRecs; ++i) {
+            std::memcpy(&nonces[i * 12], iv, 12);
+            std::memcpy(&nonces[i * 12], &i, sizeof(i));
+            recs[i] = { &nonces[i * 12], 12, iv, 5, &input[i * recLen], recLen, &ctBatch[i * recLen], &tagBatch[i * 16] };
+        }
+        auto t_one_start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < numRecs; ++i)
+            g.seal(&nonces[i * 12], 12, &input[i * recLen], recLen, iv, 5, &ctOne[i * recLen], &tagOne[i * 16]);
+        auto t_batch_start = std::chrono::high_resolution_clock::now();
+        g.seal_batch(recs.data(), numRecs);
+        auto t_batch_end = std::chrono::high_resolution_clock::now();
+        bool batchOk = ctOne == ctBatch && tagOne == tagBatch;
+
+        // ԭܣ۸ĵ 7 
+        ctBatch[7 * recLen] ^= 1;
+        std::unique_ptr<bool[]> recOk(new bool[numRecs]);
+        for (size_t i = 0; i < numRecs; ++i) {
+            recs[i].in = &ctBatch[i * recLen];
+            recs[i].tag = &tagOne[i * 16];
+        }
+        bool all = g.open_batch(recs.data(), numRecs, recOk.get());
+        batchOk = batchOk && !all && !recOk[7] && recOk[6] && recOk[8] &&
+            std::equal(ctBatch.begin(), ctBatch.begin() + 7 * recLen, input.begin());
+
+        // ռ¼126  16 ֽ + 1  32 ֽ + 1 ռ¼ǡһ (256 Կ)ٽӿռ¼ 16 ֽڼ¼
+        std::vector<size_t> lens(126, 16);
+        lens.push_back(32); lens.push_back(0); lens.push_back(0); lens.push_back(16);
+        const size_t ne = lens.size();
+        std::vector<sm4_gcm_record> erecs(ne);
+        std::vector<uint8_t> eOne(ne * 32), eBatch(ne * 32), eBack(ne * 32), eTagOne(ne * 16), eTagBatch(ne * 16);
+        std::unique_ptr<bool[]> eOk(new bool[ne]);
+        for (size_t i = 0; i < ne; ++i) {
+            g.seal(&nonces[i * 12], 12, &input[i * 32], lens[i], nullptr, 0, &eOne[i * 32], &eTagOne[i * 16]);
+            erecs[i] = { &nonces[i * 12], 12, nullptr, 0, &input[i * 32], lens[i], &eBatch[i * 32], &eTagBatch[i * 16] };
+        }
+        g.seal_batch(erecs.data(), ne);
+        batchOk = batchOk && eOne == eBatch && eTagOne == eTagBatch;
+        for (size_t i = 0; i < ne; ++i) {
+            erecs[i].in = &eBatch[i * 32];
+            erecs[i].out = &eBack[i * 32];
+        }
+        batchOk = batchOk && g.open_batch(erecs.data(), ne, eOk.get());
+        for (size_t i = 0; i < ne; ++i)
+            batchOk = batchOk && std::equal(eBack.begin() + i * 32, eBack.begin() + i * 32 + lens[i], input.begin() + i * 32);
+        std::cout << "64ֽڼ¼ seal: " << std::chrono::duration_cast<std::chrono::microseconds>(t_batch_start - t_one_start).count()
+            << " us, seal_batch: " << std::chrono::duration_cast<std::chrono::microseconds>(t_batch_end - t_batch_start).count() << " us\n";
+        std::cout << "AEAD ֤: " << (batchOk ? "ȷ" : "") << "\n\n";
+    }
+
+    std::cout << "========== ߳ SM4-GCM  ==========" << std::endl;
+    {
+        // ֿ鲢 CTR +  GHASH H^鳤 ϲӦ뵥߳ȫһ
+        const sm4_gcm_simd g(key);
+        std::vector<uint8_t> ctSerial(input.size()), ctPar(input.size()), back(input.size());
+        uint8_t tagSerial[16], tagPar[16];
+        auto t_ser_start = std::chrono::high_resolution_clock::now();
+        g.seal(iv, 12, input.data(), input.size(), nullptr, 0, ctSerial.data(), tagSerial);
+        auto t_par_start = std::chrono::high_resolution_clock::now();
+        g.seal_parallel(iv, 12, input.data(), input.size(), nullptr, 0, ctPar.data(), tagPar, pool);
+        auto t_par_end = std::chrono::high_resolution_clock::now();
+        bool parOk = ctSerial == ctPar && std::equal(tagSerial, tagSerial + 16, tagPar) &&
+            g.open_parallel(iv, 12, ctPar.data(), ctPar.size(), nullptr, 0, tagPar, back.data(), pool) && back == input;
+        std::cout << "GCM ߳: " << std::chrono::duration_cast<std::chrono::microseconds>(t_par_start - t_ser_start).count()
+            << " us, " << pool.size() << " ߳: " << std::chrono::duration_cast<std::chrono::microseconds>(t_par_end - t_par_start).count() << " us\n";
+        std::cout << "߳GCM ֤: " << (parOk ? "ȷ" : "") << "\n\n";
+    }
+
+    std::cout << "========== SM4-GMAC  ==========" << std::endl;
+    {
+        // ֻ֤ܣGMAC Ϊա AAD  GCM Tag
+        const sm4_gcm_simd g(key);
+        sm4_gmac mac(key);
+        uint8_t tagGcm[16], tagMac[16], tagStream[16];
+        auto t_gcm_start = std::chrono::high_resolution_clock::now();
+        g.seal(iv, 12, nullptr, 0, input.data(), input.size(), nullptr, tagGcm);
+        auto t_mac_start = std::chrono::high_resolution_clock::now();
+        mac.mac(iv, 12, input.data(), input.size(), tagMac);
+        auto t_mac_end = std::chrono::high_resolution_clock::now();
+
+        mac.init(iv, 12);
+        for (size_t off = 0; off < input.size(); off += 1000)
+            mac.update(&input[off], std::min<size_t>(1000, input.size() - off));
+        mac.finish(tagStream);
+        mac.init(iv, 12);
+        mac.update(input.data(), input.size());
+        bool macOk = std::equal(tagGcm, tagGcm + 16, tagMac) && std::equal(tagMac, tagMac + 16, tagStream) &&
+            mac.finish_verify(tagMac);
+        std::cout << "GMAC ʱ: " << std::chrono::duration_cast<std::chrono::microseconds>(t_mac_end - t_mac_start).count()
+            << " us (ΪAADGCM: " << std::chrono::duration_cast<std::chrono::microseconds>(t_mac_start - t_gcm_start).count() << " us)\n";
+        std::cout << "GMAC ֤: " << (macOk ? "ȷ" : "") << "\n\n";
+    }
+
+    // GHASHVPCLMULQDQ ÿ16飨ʱ⣩ PCLMULQDQ ÿ8Ա
+    {
+        uint8_t H[16] = { 0 };
+        cipher_aesni.encryptBlock(H, H);
+        ghash_clmul wideGh, narrowGh;
+        wideGh.init(H);
+        narrowGh.init(H);
+        narrowGh.setWide(false);
+        uint8_t yWide[16] = { 0 }, yNarrow[16] = { 0 };
+        auto t_w_start = std::chrono::high_resolution_clock::now();
+        wideGh.update(yWide, input.data(), input.size() / 16);
+        auto t_n_start = std::chrono::high_resolution_clock::now();
+        narrowGh.update(yNarrow, input.data(), input.size() / 16);
+        auto t_n_end = std::chrono::high_resolution_clock::now();
+        std::cout << "GHASH " << (wideGh.isWide() ? "VPCLMULQDQ 16" : "PCLMULQDQ 8(VPCLMULQDQ)") << ": "
+            << std::chrono::duration_cast<std::chrono::microseconds>(t_n_start - t_w_start).count() << " us, PCLMULQDQ 8: "
+            << std::chrono::duration_cast<std::chrono::microseconds>(t_n_end - t_n_start).count() << " us\n";
+        std::cout << "GHASH · ֤: " << (std::equal(yWide, yWide + 16, yNarrow) ? "ȷ" : "") << "\n\n";
+    }
+
+    std::cout << "========== sm4_gcm<BlockCipher, GHash> ϲ ==========" << std::endl;
+    {
+        // ͬһ GCM ģ壬ͬ SM4  GHASH ʵ֣ĺ Tag Ӧ sm4_gcm_simd һ
+        const uint8_t aad_t[7] = { 'g','c','m','-','t','p','l' };
+        std::vector<uint8_t> ref(input.size());
+        uint8_t refTag[16];
+        sm4_gcm_simd(key).seal(iv, 12, input.data(), input.size(), aad_t, sizeof(aad_t), ref.data(), refTag);
+
+        bool tplOk = true;
+        auto run = [&](const char* name, auto& g) {
+            g.setKey(key);
+            std::vector<uint8_t> ct(input.size()), back(input.size());
+            uint8_t tg[16];
+            auto t_start = std::chrono::high_resolution_clock::now();
+            g.seal(iv, 12, input.data(), input.size(), aad_t, sizeof(aad_t), ct.data(), tg);
+            auto t_end = std::chrono::high_resolution_clock::now();
+            tplOk = tplOk && ct == ref && std::equal(tg, tg + 16, refTag) &&
+                g.open(iv, 12, ct.data(), ct.size(), aad_t, sizeof(aad_t), tg, back.data()) && back == input;
+            std::cout << "sm4_gcm<" << name << ">: "
+                << std::chrono::duration_cast<std::chrono::microseconds>(t_end - t_start).count() << " us\n";
+        };
+        sm4_gcm<sm4_table, ghash_table> g1(ghash_table(8));
+        sm4_gcm<sm4_aesni, ghash_clmul> g2;
+        sm4_gcm<sm4_vaes, ghash_clmul> g3;
+        sm4_gcm<sm4_gfni, ghash_clmul> g4;
+        run("sm4_table, ghash_table(8)", g1);
+        run("sm4_aesni, ghash_clmul", g2);
+        run("sm4_vaes, ghash_clmul", g3);
+        run("sm4_gfni, ghash_clmul", g4);
+
+        // λ GHASH ֻȡǰ 64 KiB Ա
+        sm4_gcm<sm4, ghash_bitwise> g0;
+        g0.setKey(key);
+        std::vector<uint8_t> small(65536), smallRef(65536);
+        uint8_t t0[16], t0Ref[16];
+        g0.seal(iv, 12, input.data(), small.size(), aad_t, sizeof(aad_t), small.data(), t0);
+        g4.seal(iv, 12, input.data(), small.size(), aad_t, sizeof(aad_t), smallRef.data(), t0Ref);
+        tplOk = tplOk && small == smallRef && std::equal(t0, t0 + 16, t0Ref);
+        std::cout << "GCMģ ֤: " << (tplOk ? "ȷ" : "") << "\n\n";
+    }
+
+    std::cout << "========== ֤ (α챨)  ==========" << std::endl;
+    {
+        // open  GHASH Ƚ Tagͨ CTRα챨ֻ GHASH ʱ䣬д
+        const sm4_gcm_simd g(key);
+        std::vector<uint8_t> ct(input.size()), out(input.size(), 0xA5);
+        uint8_t tg[16], bad[16];
+        g.seal(iv, 12, input.data(), input.size(), nullptr, 0, ct.data(), tg);
+        std::memcpy(bad, tg, 16);
+        bad[0] ^= 1;
+
+        auto t_vf_start = std::chrono::high_resolution_clock::now();
+        bool vfRejected = !g.open(iv, 12, ct.data(), ct.size(), nullptr, 0, bad, out.data());
+        auto t_fused_start = std::chrono::high_resolution_clock::now();
+        bool untouched = std::all_of(out.begin(), out.end(), [](uint8_t b) { return b == 0xA5; });
+        bool fusedRejected = !g.open_fused(iv, 12, ct.data(), ct.size(), nullptr, 0, bad, out.data());
+        auto t_fused_end = std::chrono::high_resolution_clock::now();
+        bool wiped = std::all_of(out.begin(), out.end(), [](uint8_t b) { return b == 0; });
+
+        std::vector<uint8_t> back(input.size()), back2(input.size());
+        bool vfOk = vfRejected && untouched && fusedRejected && wiped &&
+            g.open(iv, 12, ct.data(), ct.size(), nullptr, 0, tg, back.data()) && back == input &&
+            g.open_fused(iv, 12, ct.data(), ct.size(), nullptr, 0, tg, back2.data()) && back2 == input &&
+            !g.open_parallel(iv, 12, ct.data(), ct.size(), nullptr, 0, bad, back.data(), pool) &&
+            g.open_parallel(iv, 12, ct.data(), ct.size(), nullptr, 0, tg, back.data(), pool) && back == input;
+        std::cout << "αTag ֤open: " << std::chrono::duration_cast<std::chrono::microseconds>(t_fused_start - t_vf_start).count()
+            << " us, open_fused: " << std::chrono::duration_cast<std::chrono::microseconds>(t_fused_end - t_fused_start).count() << " us\n";
+        std::cout << "֤ ֤: " << (vfOk ? "ȷ" : "") << "\n\n";
+    }
+
+    std::cout << "========== sm4_gcm_stream ʽӿڲ ==========" << std::endl;
+    {
+        // ԴСһķֶι룬ӦһԼͬ
+        const uint8_t aad_stream[13] = { 'h','e','a','d','e','r','-','s','t','r','e','a','m' };
+        std::vector<uint8_t> once(input.size()), streamed(input.size()), back(input.size());
+        uint8_t tag_once[16], tag_stream[16];
+        sm4_gcm_simd whole(key, iv, 12);
+        whole.encrypt(input.data(), input.size(), aad_stream, sizeof(aad_stream), once.data(), tag_once);
+
+        sm4_gcm_stream gs(key);
+        auto t_st_start = std::chrono::high_resolution_clock::now();
+        gs.init(iv, 12);
+        gs.update_aad(aad_stream, 5);
+        gs.update_aad(aad_stream + 5, sizeof(aad_stream) - 5);
+        for (size_t off = 0, chunk = 1; off < input.size(); off += chunk, chunk = chunk * 7 % 65521 + 1)
+            gs.update(&input[off], &streamed[off], std::min(chunk, input.size() - off));
+        gs.finish(tag_stream);
+        auto t_st_end = std::chrono::high_resolution_clock::now();
+
+        gs.init(iv, 12, true);
+        gs.update_aad(aad_stream, sizeof(aad_stream));
+        for (size_t off = 0; off < input.size(); off += 4093)
+            gs.update(&streamed[off], &back[off], std::min<size_t>(4093, input.size() - off));
+        bool streamOk = gs.finish_verify(tag_stream) && once == streamed &&
+            std::equal(tag_once, tag_once + 16, tag_stream) && back == input;
+        std::cout << "ʽGCM ֶμʱ: "
+            << std::chrono::duration_cast<std::chrono::microseconds>(t_st_end - t_st_start).count() << " us\n";
+        std::cout << "ʽGCM ֤: " << (streamOk ? "ȷ" : "") << "\n\n";
+    }
+
     return 0;
 }
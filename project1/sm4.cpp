@@ -1,45 +1,12 @@
 #include "sm4.h"
 
-uint8_t sm4::Sbox[256] = {
-    0xd6, 0x90, 0xe9, 0xfe, 0xcc, 0xe1, 0x3d, 0xb7,
-    0x16, 0xb6, 0x14, 0xc2, 0x28, 0xfb, 0x2c, 0x05,
-    0x2b, 0x67, 0x9a, 0x76, 0x2a, 0xbe, 0x04, 0xc3,
-    0xaa, 0x44, 0x13, 0x26, 0x49, 0x86, 0x06, 0x99,
-    0x9c, 0x42, 0x50, 0xf4, 0x91, 0xef, 0x98, 0x7a,
-    0x33, 0x54, 0x0b, 0x43, 0xed, 0xcf, 0xac, 0x62,
-    0xe4, 0xb3, 0x1c, 0xa9, 0xc9, 0x08, 0xe8, 0x95,
-    0x80, 0xdf, 0x94, 0xfa, 0x75, 0x8f, 0x3f, 0xa6,
-    0x47, 0x07, 0xa7, 0xfc, 0xf3, 0x73, 0x17, 0xba,
-    0x83, 0x59, 0x3c, 0x19, 0xe6, 0x85, 0x4f, 0xa8,
-    0x68, 0x6b, 0x81, 0xb2, 0x71, 0x64, 0xda, 0x8b,
-    0xf8, 0xeb, 0x0f, 0x4b, 0x70, 0x56, 0x9d, 0x35,
-    0x1e, 0x24, 0x0e, 0x5e, 0x63, 0x58, 0xd1, 0xa2,
-    0x25, 0x22, 0x7c, 0x3b, 0x01, 0x21, 0x78, 0x87,
-    0xd4, 0x00, 0x46, 0x57, 0x9f, 0xd3, 0x27, 0x52,
-    0x4c, 0x36, 0x02, 0xe7, 0xa0, 0xc4, 0xc8, 0x9e,
-    0xea, 0xbf, 0x8a, 0xd2, 0x40, 0xc7, 0x38, 0xb5,
-    0xa3, 0xf7, 0xf2, 0xce, 0xf9, 0x61, 0x15, 0xa1,
-    0xe0, 0xae, 0x5d, 0xa4, 0x9b, 0x34, 0x1a, 0x55,
-    0xad, 0x93, 0x32, 0x30, 0xf5, 0x8c, 0xb1, 0xe3,
-    0x1d, 0xf6, 0xe2, 0x2e, 0x82, 0x66, 0xca, 0x60,
-    0xc0, 0x29, 0x23, 0xab, 0x0d, 0x53, 0x4e, 0x6f,
-    0xd5, 0xdb, 0x37, 0x45, 0xde, 0xfd, 0x8e, 0x2f,
-    0x03, 0xff, 0x6a, 0x72, 0x6d, 0x6c, 0x5b, 0x51,
-    0x8d, 0x1b, 0xaf, 0x92, 0xbb, 0xdd, 0xbc, 0x7f,
-    0x11, 0xd9, 0x5c, 0x41, 0x1f, 0x10, 0x5a, 0xd8,
-    0x0a, 0xc1, 0x31, 0x88, 0xa5, 0xcd, 0x7b, 0xbd,
-    0x2d, 0x74, 0xd0, 0x12, 0xb8, 0xe5, 0xb4, 0xb0,
-    0x89, 0x69, 0x97, 0x4a, 0x0c, 0x96, 0x77, 0x7e,
-    0x65, 0xb9, 0xf1, 0x09, 0xc5, 0x6e, 0xc6, 0x84,
-    0x18, 0xf0, 0x7d, 0xec, 0x3a, 0xdc, 0x4d, 0x20,
-    0x79, 0xee, 0x5f, 0x3e, 0xd7, 0xcb, 0x39, 0x48
-};
+constexpr sm4_byte_table sm4_consts::Sbox;
 
-const uint32_t sm4::FK[4] = {
+const uint32_t sm4_consts::FK[4] = {
     0xa3b1bac6, 0x56aa3350, 0x677d9197, 0xb27022dc
 };
 
-const uint32_t sm4::CK[32] = {
+const uint32_t sm4_consts::CK[32] = {
     0x00070e15, 0x1c232a31, 0x383f464d, 0x545b6269,
     0x70777e85, 0x8c939aa1, 0xa8afb6bd, 0xc4cbd2d9,
     0xe0e7eef5, 0xfc030a11, 0x181f262d, 0x343b4249,
@@ -53,81 +20,3 @@ const uint32_t sm4::CK[32] = {
 sm4::sm4() {
     // ʼ
 }
-
-void sm4::setKey(const uint8_t key[16]) {
-    uint32_t MK[4];
-    for (int i = 0; i < 4; ++i)
-        MK[i] = (key[4 * i] << 24) | (key[4 * i + 1] << 16) | (key[4 * i + 2] << 8) | (key[4 * i + 3]);
-
-    uint32_t K[36];
-    for (int i = 0; i < 4; ++i)
-        K[i] = MK[i] ^ FK[i];
-
-    for (int i = 0; i < 32; ++i) {
-        uint32_t tmp = K[i + 1] ^ K[i + 2] ^ K[i + 3] ^ CK[i];
-        tmp = tau(tmp);
-        tmp = tmp ^ ((tmp << 13) | (tmp >> (32 - 13))) ^ ((tmp << 23) | (tmp >> (32 - 23)));
-        rk[i] = K[i] ^ tmp;
-        K[i + 4] = rk[i];
-    }
-}
-
-void sm4::encryptBlock(const uint8_t in[16], uint8_t out[16]) {
-    uint32_t X[36];
-    for (int i = 0; i < 4; ++i)
-        X[i] = (in[4 * i] << 24) | (in[4 * i + 1] << 16) | (in[4 * i + 2] << 8) | (in[4 * i + 3]);
-
-    for (int i = 0; i < 32; ++i)
-        X[i + 4] = F(X[i], X[i + 1], X[i + 2], X[i + 3], rk[i]);
-
-    for (int i = 0; i < 4; ++i) {
-        uint32_t B = X[35 - i];
-        out[4 * i] = (B >> 24) & 0xff;
-        out[4 * i + 1] = (B >> 16) & 0xff;
-        out[4 * i + 2] = (B >> 8) & 0xff;
-        out[4 * i + 3] = B & 0xff;
-    }
-}
-
-void sm4::decryptBlock(const uint8_t in[16], uint8_t out[16]) {
-    uint32_t X[36];
-    for (int i = 0; i < 4; ++i)
-        X[i] = (in[4 * i] << 24) | (in[4 * i + 1] << 16) | (in[4 * i + 2] << 8) | (in[4 * i + 3]);
-
-    for (int i = 0; i < 32; ++i)
-        X[i + 4] = F(X[i], X[i + 1], X[i + 2], X[i + 3], rk[31 - i]);
-
-    for (int i = 0; i < 4; ++i) {
-        uint32_t B = X[35 - i];
-        out[4 * i] = (B >> 24) & 0xff;
-        out[4 * i + 1] = (B >> 16) & 0xff;
-        out[4 * i + 2] = (B >> 8) & 0xff;
-        out[4 * i + 3] = B & 0xff;
-    }
-}
-
-uint32_t sm4::F(uint32_t x0, uint32_t x1, uint32_t x2, uint32_t x3, uint32_t rk) {
-    return x0 ^ T(x1 ^ x2 ^ x3 ^ rk);
-}
-
-uint32_t sm4::T(uint32_t x) {
-    return L(tau(x));
-}
-
-uint32_t sm4::L(uint32_t x) {
-    return x ^ ((x << 2) | (x >> (32 - 2))) ^ ((x << 10) | (x >> (32 - 10))) ^
-        ((x << 18) | (x >> (32 - 18))) ^ ((x << 24) | (x >> (32 - 24)));
-}
-
-uint32_t sm4::tau(uint32_t x) {
-    uint8_t a[4] = {
-        static_cast<uint8_t>(x >> 24),
-        static_cast<uint8_t>(x >> 16),
-        static_cast<uint8_t>(x >> 8),
-        static_cast<uint8_t>(x)
-    };
-    for (int i = 0; i < 4; ++i)
-        a[i] = Sbox[a[i]];
-
-    return (a[0] << 24) | (a[1] << 16) | (a[2] << 8) | a[3];
-}
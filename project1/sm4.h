@@ -4,29 +4,13 @@
 #define SM4_H
 
 #include <cstdint>
+#include "sm4_core.h"
 
-class sm4 {
+// Reference SM4: byte-wise S-box lookups and rotate-based L.
+// rk is inherited (protected) so the SIMD backends can reuse the key schedule.
+class sm4 : public sm4_core<sm4_sbox_bytes, sm4_linear_rotl> {
 public:
     sm4();
-    void setKey(const uint8_t key[16]);
-    void encryptBlock(const uint8_t in[16], uint8_t out[16]);
-    void decryptBlock(const uint8_t in[16], uint8_t out[16]);
-
-
-protected:
-    uint32_t rk[32];
-
-private:
-    // uint32_t rk[32]; // round keys
-
-    uint32_t F(uint32_t x0, uint32_t x1, uint32_t x2, uint32_t x3, uint32_t rk);
-    uint32_t T(uint32_t x);
-    virtual uint32_t L(uint32_t x);
-    uint32_t tau(uint32_t x);
-
-    static uint8_t Sbox[256];
-    static const uint32_t FK[4];
-    static const uint32_t CK[32];
 };
 
 #endif
@@ -1,37 +1,112 @@
 #include "sm4_aesni.h"
+#include "sm4_engine.h"
+
+void sm4_aesni::setKey(const uint8_t key[16]) {
+    sm4::setKey(key);
+    for (int i = 0; i < 32; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            rkx[0][i][j] = rk[i];
+            rkx[1][i][j] = rk[31 - i];
+        }
+    }
+}
+
+void sm4_aesni::setExpandedKey(const sm4_expanded_key& xk) {
+    sm4::setExpandedKey(xk);
+    std::memcpy(rkx[0], xk.rk_x4, sizeof(rkx[0]));
+    std::memcpy(rkx[1], xk.rk_rev_x4, sizeof(rkx[1]));
+}
+
+// ܣںֻװ/дһ
+void sm4_aesni::encryptBlock(const uint8_t in[16], uint8_t out[16]) const {
+    SM4_AESNI_do(in, out, rkx[0], 1);
+}
+
+// 
+void sm4_aesni::decryptBlock(const uint8_t in[16], uint8_t out[16]) const {
+    SM4_AESNI_do(in, out, rkx[1], 1);
+}
+
+void sm4_aesni::encryptBlocks8(const uint8_t* plaintext, uint8_t* ciphertext) const {
+    SM4_AESNI_do(plaintext, ciphertext, rkx[0]);
+    SM4_AESNI_do(plaintext + 64, ciphertext + 64, rkx[0]); // 4飨64ֽƫƣ
+}
+
+void sm4_aesni::decryptBlocks8(const uint8_t* ciphertext, uint8_t* plaintext) const {
+    SM4_AESNI_do(ciphertext, plaintext, rkx[1]);
+    SM4_AESNI_do(ciphertext + 64, plaintext + 64, rkx[1]); // 4飨64ֽƫƣ
+}
 
-// ģ8
-void sm4_aesni::encryptBlock(const uint8_t in[16], uint8_t out[16]) {
-    alignas(16) uint8_t in8[128] = { 0 };
-    alignas(16) uint8_t out8[128] = { 0 };
-    std::memcpy(in8, in, 16);
-    SM4_AESNI_do(in8, out8, rk, 0);
-    std::memcpy(out, out8, 16);
+void sm4_aesni::encryptBlocks(const uint8_t* in, uint8_t* out, size_t nblocks) const {
+    for (size_t i = 0; i < nblocks; i += 4)
+        SM4_AESNI_do(in + 16 * i, out + 16 * i, rkx[0], nblocks - i < 4 ? nblocks - i : 4);
 }
 
-// ģ8
-void sm4_aesni::decryptBlock(const uint8_t in[16], uint8_t out[16]) {
-    alignas(16) uint8_t in8[128] = { 0 };
-    alignas(16) uint8_t out8[128] = { 0 };
-    std::memcpy(in8, in, 16);
-    SM4_AESNI_do(in8, out8, rk, 1);
-    std::memcpy(out, out8, 16);
+void sm4_aesni::decryptBlocks(const uint8_t* in, uint8_t* out, size_t nblocks) const {
+    for (size_t i = 0; i < nblocks; i += 4)
+        SM4_AESNI_do(in + 16 * i, out + 16 * i, rkx[1], nblocks - i < 4 ? nblocks - i : 4);
 }
 
+void sm4_aesni::encryptBlocksMultiKey(const uint32_t* const rks[], const uint8_t* in, uint8_t* out, size_t nblocks) {
+    cryptBlocksMultiKey(rks, in, out, nblocks, false);
+}
+
+void sm4_aesni::decryptBlocksMultiKey(const uint32_t* const rks[], const uint8_t* in, uint8_t* out, size_t nblocks) {
+    cryptBlocksMultiKey(rks, in, out, nblocks, true);
+}
 
+void sm4_aesni::cryptBlocksInterleaved(const uint32_t (*rkx)[4], const uint8_t* in, uint8_t* out, size_t n) {
+    SM4_AESNI_do(in, out, rkx, n);
+}
 
-void sm4_aesni::encryptBlocks8(const uint8_t* plaintext, uint8_t* ciphertext) {
-    SM4_AESNI_do(const_cast<uint8_t*> (plaintext), ciphertext, rk, 0);
-    SM4_AESNI_do(const_cast<uint8_t*> (plaintext + 64), ciphertext + 64, rk, 0); // 4飨64ֽƫƣ
+// ÿ4ѸԵԿתó [32][4]ںÿװһμõͨͬԿ
+void sm4_aesni::cryptBlocksMultiKey(const uint32_t* const rks[], const uint8_t* in, uint8_t* out, size_t nblocks, bool dec) {
+    alignas(16) uint32_t rkx[32][4];
+    for (size_t i = 0; i < nblocks; i += 4) {
+        size_t n = nblocks - i < 4 ? nblocks - i : 4;
+        for (int r = 0; r < 32; ++r)
+            for (size_t j = 0; j < 4; ++j)
+                rkx[r][j] = j < n ? rks[i + j][dec ? 31 - r : r] : 0;
+        SM4_AESNI_do(in + 16 * i, out + 16 * i, rkx, n);
+    }
 }
 
-void sm4_aesni::decryptBlocks8(const uint8_t* ciphertext, uint8_t* plaintext) {
-    SM4_AESNI_do(const_cast<uint8_t*> (ciphertext), plaintext, rk, 1);
-    SM4_AESNI_do(const_cast<uint8_t*>(ciphertext + 64), plaintext + 64, rk, 1); // 4飨64ֽƫƣ
+// ԿֺṹֻͬԱ任 L'(x) = x ^ (x <<< 13) ^ (x <<< 23)
+// ͨԿ [32][4] еһ
+SM4_TARGET("ssse3,aes") void sm4_aesni::setKeys(const uint8_t keys[][16], size_t n, uint32_t (*rkx)[32][4], uint32_t (*rkx_dec)[32][4]) {
+    __m128i vindex = _mm_setr_epi8(
+        3, 2, 1, 0,
+        7, 6, 5, 4,
+        11, 10, 9, 8,
+        15, 14, 13, 12);
+
+    for (size_t g = 0; g * 4 < n; ++g) {
+        size_t m = n - 4 * g < 4 ? n - 4 * g : 4;
+        __m128i K[4], Tmp[4];
+        for (size_t j = 0; j < 4; ++j)
+            Tmp[j] = j < m ? _mm_loadu_si128((const __m128i*)keys[4 * g + j]) : _mm_setzero_si128();
+
+        K[0] = _mm_shuffle_epi8(MM_PACK0_EPI32(Tmp[0], Tmp[1], Tmp[2], Tmp[3]), vindex);
+        K[1] = _mm_shuffle_epi8(MM_PACK1_EPI32(Tmp[0], Tmp[1], Tmp[2], Tmp[3]), vindex);
+        K[2] = _mm_shuffle_epi8(MM_PACK2_EPI32(Tmp[0], Tmp[1], Tmp[2], Tmp[3]), vindex);
+        K[3] = _mm_shuffle_epi8(MM_PACK3_EPI32(Tmp[0], Tmp[1], Tmp[2], Tmp[3]), vindex);
+        for (int j = 0; j < 4; ++j)
+            K[j] = MM_XOR2(K[j], _mm_set1_epi32((int)sm4_consts::FK[j]));
+
+        for (int i = 0; i < 32; i++) {
+            Tmp[0] = MM_XOR4(K[1], K[2], K[3], _mm_set1_epi32((int)sm4_consts::CK[i]));
+            Tmp[0] = SM4_SBox(Tmp[0]);
+            Tmp[0] = MM_XOR4(K[0], Tmp[0], MM_ROTL_EPI32(Tmp[0], 13), MM_ROTL_EPI32(Tmp[0], 23));
+            _mm_store_si128((__m128i*)rkx[g][i], Tmp[0]);
+            if (rkx_dec)
+                _mm_store_si128((__m128i*)rkx_dec[g][31 - i], Tmp[0]);
+            K[0] = K[1]; K[1] = K[2]; K[2] = K[3]; K[3] = Tmp[0];
+        }
+    }
 }
 
 // ӽܺ
-void sm4_aesni::SM4_AESNI_do(uint8_t* in, uint8_t* out, const uint32_t* rk, int enc) {
+SM4_TARGET("ssse3,aes") void sm4_aesni::SM4_AESNI_do(const uint8_t* in, uint8_t* out, const uint32_t (*rkx)[4], size_t n) {
     __m128i X[4], Tmp[4];
     __m128i vindex = _mm_setr_epi8(
         3, 2, 1, 0,
@@ -39,11 +114,9 @@ void sm4_aesni::SM4_AESNI_do(uint8_t* in, uint8_t* out, const uint32_t* rk, int
         11, 10, 9, 8,
         15, 14, 13, 12);
 
-    // Load 4 * 128bit blocks = 512 bytes ? No, 4*16 bytes = 64 bytes, so loading 4 __m128i from input + 4 more blocks from in+16, +32, +48...
-    Tmp[0] = _mm_loadu_si128((const __m128i*)in + 0);
-    Tmp[1] = _mm_loadu_si128((const __m128i*)in + 1);
-    Tmp[2] = _mm_loadu_si128((const __m128i*)in + 2);
-    Tmp[3] = _mm_loadu_si128((const __m128i*)in + 3);
+    // ֻװǰ n 飬ͨ㣨Խ
+    for (size_t j = 0; j < 4; ++j)
+        Tmp[j] = j < n ? _mm_loadu_si128((const __m128i*)in + j) : _mm_setzero_si128();
 
     X[0] = MM_PACK0_EPI32(Tmp[0], Tmp[1], Tmp[2], Tmp[3]);
     X[1] = MM_PACK1_EPI32(Tmp[0], Tmp[1], Tmp[2], Tmp[3]);
@@ -57,7 +130,7 @@ void sm4_aesni::SM4_AESNI_do(uint8_t* in, uint8_t* out, const uint32_t* rk, int
     X[3] = _mm_shuffle_epi8(X[3], vindex);
 
     for (int i = 0; i < 32; i++) {
-        __m128i k = _mm_set1_epi32(enc == 0 ? rk[i] : rk[31 - i]);
+        __m128i k = _mm_load_si128((const __m128i*)rkx[i]);
         Tmp[0] = MM_XOR4(X[1], X[2], X[3], k);
         Tmp[0] = SM4_SBox(Tmp[0]);
         Tmp[0] = MM_XOR6(X[0], Tmp[0],
@@ -73,13 +146,15 @@ void sm4_aesni::SM4_AESNI_do(uint8_t* in, uint8_t* out, const uint32_t* rk, int
     X[2] = _mm_shuffle_epi8(X[2], vindex);
     X[3] = _mm_shuffle_epi8(X[3], vindex);
 
-    _mm_storeu_si128((__m128i*)out + 0, MM_PACK0_EPI32(X[3], X[2], X[1], X[0]));
-    _mm_storeu_si128((__m128i*)out + 1, MM_PACK1_EPI32(X[3], X[2], X[1], X[0]));
-    _mm_storeu_si128((__m128i*)out + 2, MM_PACK2_EPI32(X[3], X[2], X[1], X[0]));
-    _mm_storeu_si128((__m128i*)out + 3, MM_PACK3_EPI32(X[3], X[2], X[1], X[0]));
+    Tmp[0] = MM_PACK0_EPI32(X[3], X[2], X[1], X[0]);
+    Tmp[1] = MM_PACK1_EPI32(X[3], X[2], X[1], X[0]);
+    Tmp[2] = MM_PACK2_EPI32(X[3], X[2], X[1], X[0]);
+    Tmp[3] = MM_PACK3_EPI32(X[3], X[2], X[1], X[0]);
+    for (size_t j = 0; j < n; ++j)
+        _mm_storeu_si128((__m128i*)out + j, Tmp[j]);
 }
 
-__m128i sm4_aesni::MulMatrix(__m128i x, __m128i higherMask, __m128i lowerMask) {
+SM4_TARGET("ssse3,aes") __m128i sm4_aesni::MulMatrix(__m128i x, __m128i higherMask, __m128i lowerMask) {
     __m128i tmp1, tmp2;
     __m128i andMask = _mm_set1_epi32(0x0f0f0f0f);
     tmp2 = _mm_srli_epi16(x, 4);
@@ -91,7 +166,7 @@ __m128i sm4_aesni::MulMatrix(__m128i x, __m128i higherMask, __m128i lowerMask) {
     return tmp1;
 }
 
-__m128i sm4_aesni::MulMatrixATA(__m128i x) {
+SM4_TARGET("ssse3,aes") __m128i sm4_aesni::MulMatrixATA(__m128i x) {
     __m128i higherMask = _mm_set_epi8(
         0x14, 0x07, (char)0xc6, (char)0xd5, 0x6c, 0x7f, (char)0xbe, (char)0xad,
         (char)0xb9, (char)0xaa, 0x6b, 0x78, (char)0xc1, (char)0xd2, 0x13, 0x00);
@@ -104,7 +179,7 @@ __m128i sm4_aesni::MulMatrixATA(__m128i x) {
 }
 
 
-__m128i sm4_aesni::MulMatrixTA(__m128i x) {
+SM4_TARGET("ssse3,aes") __m128i sm4_aesni::MulMatrixTA(__m128i x) {
     __m128i higherMask = _mm_set_epi8(
         0x22, 0x58, 0x1a, 0x60, 0x02, 0x78, 0x3a, 0x40,
         0x62, 0x18, 0x5a, 0x20, 0x42, 0x38, 0x7a, 0x00);
@@ -116,17 +191,17 @@ __m128i sm4_aesni::MulMatrixTA(__m128i x) {
     return MulMatrix(x, higherMask, lowerMask);
 }
 
-__m128i sm4_aesni::AddTC(__m128i x) {
+SM4_TARGET("ssse3,aes") __m128i sm4_aesni::AddTC(__m128i x) {
     __m128i TC = _mm_set1_epi8(0b00100011);
     return _mm_xor_si128(x, TC);
 }
 
-__m128i sm4_aesni::AddATAC(__m128i x) {
+SM4_TARGET("ssse3,aes") __m128i sm4_aesni::AddATAC(__m128i x) {
     __m128i ATAC = _mm_set1_epi8(0b00111011);
     return _mm_xor_si128(x, ATAC);
 }
 
-__m128i sm4_aesni::SM4_SBox(__m128i x) {
+SM4_TARGET("ssse3,aes") __m128i sm4_aesni::SM4_SBox(__m128i x) {
     __m128i MASK = _mm_set_epi8(
         0x03, 0x06, 0x09, 0x0c,
         0x0f, 0x02, 0x05, 0x08,
@@ -6,25 +6,55 @@
 #include <immintrin.h>
 #include <cstring>
 
-class sm4_aesni : public sm4 {
+// עں˺Դ target("ssse3,aes") ԣļ -m ѡ (GCC/Clang)
+
+// ǹм̳Уrkx  setKey/setExpandedKey  rk ܾ sm4& 
+// sm4::setKey Կrk ¶ rkx ǾԿ
+class sm4_aesni : protected sm4 {
 public:
     sm4_aesni() = default;
 
-    // дܣ8ģⵥ
-    void encryptBlock(const uint8_t in[16], uint8_t out[16]) ;
+    // Կչ˳ɹ㲥õԿ
+    void setKey(const uint8_t key[16]);
+    // ֱʹûеչԿ㲥Կ¼
+    void setExpandedKey(const sm4_expanded_key& xk);
+
+    // ܣֻװһ4·ںˣٲ㿽
+    void encryptBlock(const uint8_t in[16], uint8_t out[16]) const;
 
-    // дܣ8ģⵥ
-    void decryptBlock(const uint8_t in[16], uint8_t out[16]) ;
+    // 
+    void decryptBlock(const uint8_t in[16], uint8_t out[16]) const;
 
     // 8ܽӿڣin/outΪ128ֽڻ
-    void encryptBlocks8(const uint8_t* plaintext, uint8_t* ciphertext);
+    void encryptBlocks8(const uint8_t* plaintext, uint8_t* ciphertext) const;
 
     // 8ܽӿ
-    void decryptBlocks8(const uint8_t* ciphertext, uint8_t* plaintext);
+    void decryptBlocks8(const uint8_t* ciphertext, uint8_t* plaintext) const;
+
+    // ӽܣβ4ʱ鲿װ
+    void encryptBlocks(const uint8_t* in, uint8_t* out, size_t nblocks) const;
+    void decryptBlocks(const uint8_t* in, uint8_t* out, size_t nblocks) const;
+
+    // Կӽܣ i ʹ rks[i] ָ32ԿsetKey չ
+    // ͬỰСͬһ4ͨ
+    static void encryptBlocksMultiKey(const uint32_t* const rks[], const uint8_t* in, uint8_t* out, size_t nblocks);
+    static void decryptBlocksMultiKey(const uint32_t* const rks[], const uint8_t* in, uint8_t* out, size_t nblocks);
+
+    // ԤתúõĶԿԿrkx[r][j] Ϊ j  r ʹõԿn <= 4
+    // ܻǽֻȡ rkx ִ˳
+    static void cryptBlocksInterleaved(const uint32_t (*rkx)[4], const uint8_t* in, uint8_t* out, size_t n);
+
+    // Կչÿ4Կռһ4ͨͬʱ32ԿţS AES-NI
+    // rkx[g] д 4g..4g+3 Կ [32][4] Կֱӽ cryptBlocksInterleaved
+    // rkx_dec ǿʱͬʱд˳ű16ֽڶ룻n 4ıʱһͨ
+    static void setKeys(const uint8_t keys[][16], size_t n, uint32_t (*rkx)[32][4], uint32_t (*rkx_dec)[32][4] = nullptr);
 
 private:
-    // ڲ̬/ܺĺ
-    static void SM4_AESNI_do(uint8_t* in, uint8_t* out, const uint32_t* rk, int enc);
+    static void cryptBlocksMultiKey(const uint32_t* const rks[], const uint8_t* in, uint8_t* out, size_t nblocks, bool dec);
+
+    // ڲ̬/ܺĺ n (1..4) 
+    // rkx Ϊ˳źáÿԿ㲥128λ32Կ
+    static void SM4_AESNI_do(const uint8_t* in, uint8_t* out, const uint32_t (*rkx)[4], size_t n = 4);
 
     static __m128i SM4_SBox(__m128i x);
 
@@ -51,6 +81,9 @@ private:
     static __m128i MulMatrixTA(__m128i x);
     static __m128i AddTC(__m128i x);
     static __m128i AddATAC(__m128i x);
+
+    // rkx[0] ˳rkx[1] ˳
+    alignas(16) uint32_t rkx[2][32][4];
 };
 
 #endif
@@ -0,0 +1,382 @@
+#include "sm4_bitslice.h"
+#include "sm4_engine.h"
+#include <immintrin.h>
+
+// ---------------- plane types ----------------
+// One plane holds the same bit position of 64 (uint64_t), 128 or 256 blocks.
+
+struct bs64 {
+    uint64_t v;
+    static const int groups = 1;
+    static bs64 load(const uint64_t* p) { return { p[0] }; }
+    static void store(uint64_t* p, bs64 x) { p[0] = x.v; }
+    static bs64 mask(uint32_t bit) { return { 0 - (uint64_t)bit }; }
+};
+static inline bs64 operator^(bs64 a, bs64 b) { return { a.v ^ b.v }; }
+static inline bs64 operator&(bs64 a, bs64 b) { return { a.v & b.v }; }
+static inline bs64 operator~(bs64 a) { return { ~a.v }; }
+
+struct bs128 {
+    __m128i v;
+    static const int groups = 2;
+    static bs128 load(const uint64_t* p) { return { _mm_loadu_si128((const __m128i*)p) }; }
+    static void store(uint64_t* p, bs128 x) { _mm_storeu_si128((__m128i*)p, x.v); }
+    static bs128 mask(uint32_t bit) { return { _mm_set1_epi32(0 - (int)bit) }; }
+};
+static inline bs128 operator^(bs128 a, bs128 b) { return { _mm_xor_si128(a.v, b.v) }; }
+static inline bs128 operator&(bs128 a, bs128 b) { return { _mm_and_si128(a.v, b.v) }; }
+static inline bs128 operator~(bs128 a) { return { _mm_xor_si128(a.v, _mm_set1_epi32(-1)) }; }
+
+// AVX2 only inside bs256_do() below; bs64/bs128 stay at the baseline ISA
+struct bs256 {
+    __m256i v;
+    static const int groups = 4;
+    SM4_TARGET("avx2") static bs256 load(const uint64_t* p) { return { _mm256_loadu_si256((const __m256i*)p) }; }
+    SM4_TARGET("avx2") static void store(uint64_t* p, bs256 x) { _mm256_storeu_si256((__m256i*)p, x.v); }
+    SM4_TARGET("avx2") static bs256 mask(uint32_t bit) { return { _mm256_set1_epi32(0 - (int)bit) }; }
+};
+SM4_TARGET("avx2") static inline bs256 operator^(bs256 a, bs256 b) { return { _mm256_xor_si256(a.v, b.v) }; }
+SM4_TARGET("avx2") static inline bs256 operator&(bs256 a, bs256 b) { return { _mm256_and_si256(a.v, b.v) }; }
+SM4_TARGET("avx2") static inline bs256 operator~(bs256 a) { return { _mm256_xor_si256(a.v, _mm256_set1_epi32(-1)) }; }
+
+// ---------------- S-box circuit ----------------
+// p[0..7] are the planes of one byte, p[0] = least significant bit.
+// S(x) = M2 * inv(M1 * x + c1) + c2 (the same decomposition as sm4_gfni), with
+// the GF(2^8) inversion taken from the Boyar-Peralta AES circuit and the
+// affine maps folded into its top and bottom linear layers: 32 AND, 114 XOR/NOT.
+template <class V>
+static inline void SM4_SBox_bs(V* p) {
+    const V x0 = p[0];
+    const V x1 = p[1];
+    const V x2 = p[2];
+    const V x3 = p[3];
+    const V x4 = p[4];
+    const V x5 = p[5];
+    const V x6 = p[6];
+    const V x7 = p[7];
+    const V a0 = x0 ^ x1;
+    const V a1 = x4 ^ x5;
+    const V a2 = x3 ^ x6;
+    const V a3 = x2 ^ x7;
+    const V a4 = x2 ^ a0;
+    const V a5 = a1 ^ a2;
+    const V a6 = x0 ^ x4;
+    const V a7 = x1 ^ x3;
+    const V a8 = x7 ^ a0;
+    const V a9 = a0 ^ a3;
+    const V ux7 = ~(x1 ^ x2);
+    const V y1 = x5 ^ a2 ^ a9;
+    const V y2 = x1 ^ x5 ^ x6 ^ x7;
+    const V y3 = ~(a5 ^ a9);
+    const V y4 = x6 ^ a3 ^ a6;
+    const V y5 = ~(x7 ^ a5);
+    const V y6 = x4 ^ a0;
+    const V y7 = x0 ^ a1 ^ a3;
+    const V y8 = a4;
+    const V y9 = a1 ^ a4;
+    const V y10 = a3 ^ a5;
+    const V y11 = ~(a1 ^ a8);
+    const V y12 = ~(x5 ^ a7);
+    const V y13 = ~(x4 ^ a7);
+    const V y14 = a1;
+    const V y15 = ~(x2 ^ a6);
+    const V y16 = x1 ^ x4 ^ a2;
+    const V y17 = ~(a2 ^ a4);
+    const V y18 = x4 ^ x6 ^ a4;
+    const V y19 = a5 ^ a8;
+    const V y20 = ~a3;
+    const V y21 = ~x6;
+    const V t2 = y12 & y15;
+    const V t3 = y3 & y6;
+    const V t4 = t3 ^ t2;
+    const V t5 = y4 & ux7;
+    const V t6 = t5 ^ t2;
+    const V t7 = y13 & y16;
+    const V t8 = y5 & y1;
+    const V t9 = t8 ^ t7;
+    const V t10 = y2 & y7;
+    const V t11 = t10 ^ t7;
+    const V t12 = y9 & y11;
+    const V t13 = y14 & y17;
+    const V t14 = t13 ^ t12;
+    const V t15 = y8 & y10;
+    const V t16 = t15 ^ t12;
+    const V t17 = t4 ^ t14;
+    const V t18 = t6 ^ t16;
+    const V t19 = t9 ^ t14;
+    const V t20 = t11 ^ t16;
+    const V t21 = t17 ^ y20;
+    const V t22 = t18 ^ y19;
+    const V t23 = t19 ^ y21;
+    const V t24 = t20 ^ y18;
+    const V t25 = t21 ^ t22;
+    const V t26 = t21 & t23;
+    const V t27 = t24 ^ t26;
+    const V t28 = t25 & t27;
+    const V t29 = t28 ^ t22;
+    const V t30 = t23 ^ t24;
+    const V t31 = t22 ^ t26;
+    const V t32 = t31 & t30;
+    const V t33 = t32 ^ t24;
+    const V t34 = t23 ^ t33;
+    const V t35 = t27 ^ t33;
+    const V t36 = t24 & t35;
+    const V t37 = t36 ^ t34;
+    const V t38 = t27 ^ t36;
+    const V t39 = t29 & t38;
+    const V t40 = t25 ^ t39;
+    const V t41 = t40 ^ t37;
+    const V t42 = t29 ^ t33;
+    const V t43 = t29 ^ t40;
+    const V t44 = t33 ^ t37;
+    const V t45 = t42 ^ t41;
+    const V z0 = t44 & y15;
+    const V z1 = t37 & y6;
+    const V z2 = t33 & ux7;
+    const V z3 = t43 & y16;
+    const V z4 = t40 & y1;
+    const V z5 = t29 & y7;
+    const V z6 = t42 & y11;
+    const V z7 = t45 & y17;
+    const V z8 = t41 & y10;
+    const V z9 = t44 & y12;
+    const V z10 = t37 & y3;
+    const V z11 = t33 & y4;
+    const V z12 = t43 & y13;
+    const V z13 = t40 & y5;
+    const V z14 = t29 & y2;
+    const V z15 = t42 & y9;
+    const V z16 = t45 & y14;
+    const V z17 = t41 & y8;
+    const V w0 = z1 ^ z8;
+    const V w1 = z3 ^ z14;
+    const V w2 = z7 ^ w0;
+    const V w3 = z0 ^ z5;
+    const V w4 = z10 ^ z11;
+    const V w5 = z12 ^ z15;
+    const V w6 = z16 ^ w4;
+    const V w7 = z17 ^ w1;
+    const V w8 = z2 ^ w2;
+    const V w9 = z4 ^ z6;
+    const V w10 = z13 ^ w7;
+    const V w11 = z14 ^ w5;
+    const V w12 = w2 ^ w3;
+    const V w13 = w6 ^ w11;
+    p[7] = ~(w5 ^ w7 ^ w12);
+    p[6] = ~(z9 ^ z10 ^ z15 ^ w10 ^ w12);
+    p[5] = w8;
+    p[4] = ~(z17 ^ w6);
+    p[3] = w8 ^ w13;
+    p[2] = w0 ^ w3 ^ w9 ^ w13;
+    p[1] = ~(z7 ^ z16 ^ w9 ^ w10);
+    p[0] = ~(z5 ^ z6 ^ z8 ^ z9 ^ z11 ^ z12 ^ w1);
+}
+
+// ---------------- transpose ----------------
+
+// In-place 64x64 bit matrix transpose: bit c of a[k] <-> bit (63-k) of a[63-c]
+static void transpose64(uint64_t a[64]) {
+    uint64_t m = 0x00000000FFFFFFFFULL;
+    for (int j = 32; j != 0; j >>= 1, m ^= m << j) {
+        for (int k = 0; k < 64; k = ((k | j) + 1) & ~j) {
+            uint64_t t = (a[k] ^ (a[k | j] >> j)) & m;
+            a[k] ^= t;
+            a[k | j] ^= t << j;
+        }
+    }
+}
+
+static inline uint32_t load32be(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static inline void store32be(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24); p[1] = (uint8_t)(v >> 16); p[2] = (uint8_t)(v >> 8); p[3] = (uint8_t)v;
+}
+
+// Plane buffer layout: buf[plane][group]; plane 32*w + j is bit j of word w.
+// Words 0/1 of every block form one 64x64 matrix, words 2/3 the other.
+// Only the first n blocks are read/written, missing ones are zero lanes.
+template <int G>
+static void bs_pack(const uint8_t* in, uint64_t (*buf)[G], size_t n) {
+    uint64_t a[2][64];
+    for (int g = 0; g < G; ++g) {
+        for (size_t b = 0; b < 64; ++b) {
+            if (64 * g + b >= n) {
+                a[0][b] = a[1][b] = 0;
+                continue;
+            }
+            const uint8_t* blk = in + 16 * (64 * g + b);
+            a[0][b] = ((uint64_t)load32be(blk) << 32) | load32be(blk + 4);
+            a[1][b] = ((uint64_t)load32be(blk + 8) << 32) | load32be(blk + 12);
+        }
+        transpose64(a[0]);
+        transpose64(a[1]);
+        for (int j = 0; j < 32; ++j) {
+            buf[j][g] = a[0][31 - j];
+            buf[32 + j][g] = a[0][63 - j];
+            buf[64 + j][g] = a[1][31 - j];
+            buf[96 + j][g] = a[1][63 - j];
+        }
+    }
+}
+
+template <int G>
+static void bs_unpack(uint64_t (*buf)[G], uint8_t* out, size_t n) {
+    uint64_t a[2][64];
+    for (int g = 0; g < G; ++g) {
+        for (int j = 0; j < 32; ++j) {
+            a[0][31 - j] = buf[j][g];
+            a[0][63 - j] = buf[32 + j][g];
+            a[1][31 - j] = buf[64 + j][g];
+            a[1][63 - j] = buf[96 + j][g];
+        }
+        transpose64(a[0]);
+        transpose64(a[1]);
+        for (size_t b = 0; b < 64 && 64 * g + b < n; ++b) {
+            uint8_t* blk = out + 16 * (64 * g + b);
+            store32be(blk, (uint32_t)(a[0][b] >> 32));
+            store32be(blk + 4, (uint32_t)a[0][b]);
+            store32be(blk + 8, (uint32_t)(a[1][b] >> 32));
+            store32be(blk + 12, (uint32_t)a[1][b]);
+        }
+    }
+}
+
+// ---------------- rounds ----------------
+
+template <class V>
+static void SM4_bitslice_do(const uint8_t* in, uint8_t* out, const uint32_t* rk, int enc, size_t n = 64 * V::groups) {
+    const int G = V::groups;
+    uint64_t buf[128][G];
+    V X[4][32], t[32];
+
+    bs_pack<G>(in, buf, n);
+    for (int w = 0; w < 4; ++w)
+        for (int j = 0; j < 32; ++j)
+            X[w][j] = V::load(buf[32 * w + j]);
+
+    // X[r % 4] is overwritten in round r, so after 32 rounds X[s] = X_{32+s}
+    for (int r = 0; r < 32; ++r) {
+        uint32_t k = enc == 0 ? rk[r] : rk[31 - r];
+        V* x0 = X[r & 3];
+        const V* x1 = X[(r + 1) & 3];
+        const V* x2 = X[(r + 2) & 3];
+        const V* x3 = X[(r + 3) & 3];
+        for (int j = 0; j < 32; ++j)
+            t[j] = x1[j] ^ x2[j] ^ x3[j] ^ V::mask((k >> j) & 1);
+
+        // byte m of the word is planes 8m..8m+7
+        for (int m = 0; m < 4; ++m)
+            SM4_SBox_bs(t + 8 * m);
+
+        // L: bit j of (t <<< n) is bit (j - n) mod 32 of t
+        for (int j = 0; j < 32; ++j)
+            x0[j] = x0[j] ^ t[j] ^ t[(j + 30) & 31] ^ t[(j + 22) & 31] ^ t[(j + 14) & 31] ^ t[(j + 8) & 31];
+    }
+
+    // output words are (X35, X34, X33, X32)
+    for (int w = 0; w < 4; ++w)
+        for (int j = 0; j < 32; ++j)
+            V::store(buf[32 * w + j], X[3 - w][j]);
+    bs_unpack<G>(buf, out, n);
+}
+
+// The generic rounds are compiled for the baseline ISA; flattening them into
+// this AVX2 function is what turns the bs256 instance into one ymm kernel.
+SM4_TARGET("avx2") SM4_FLATTEN
+static void bs256_do(const uint8_t* in, uint8_t* out, const uint32_t* rk, int enc, size_t n = 256) {
+    SM4_bitslice_do<bs256>(in, out, rk, enc, n);
+}
+
+// ---------------- key schedule ----------------
+
+// tau on one word: the four bytes sit in lanes 0..3 of a single plane set
+static uint32_t tau_ct(uint32_t x) {
+    bs64 p[8];
+    for (int i = 0; i < 8; ++i) {
+        p[i].v = 0;
+        for (int m = 0; m < 4; ++m)
+            p[i].v |= (uint64_t)((x >> (8 * m + i)) & 1) << m;
+    }
+    SM4_SBox_bs(p);
+    uint32_t y = 0;
+    for (int i = 0; i < 8; ++i)
+        for (int m = 0; m < 4; ++m)
+            y |= (uint32_t)((p[i].v >> m) & 1) << (8 * m + i);
+    return y;
+}
+
+void sm4_bitslice::setKey(const uint8_t key[16]) {
+    uint32_t K[36];
+    for (int i = 0; i < 4; ++i)
+        K[i] = load32be(key + 4 * i) ^ sm4_consts::FK[i];
+
+    for (int i = 0; i < 32; ++i) {
+        uint32_t tmp = tau_ct(K[i + 1] ^ K[i + 2] ^ K[i + 3] ^ sm4_consts::CK[i]);
+        tmp = tmp ^ ((tmp << 13) | (tmp >> (32 - 13))) ^ ((tmp << 23) | (tmp >> (32 - 23)));
+        rk[i] = K[i] ^ tmp;
+        K[i + 4] = rk[i];
+    }
+}
+
+void sm4_bitslice::encryptBlocks64(const uint8_t* plaintext, uint8_t* ciphertext) const {
+    SM4_bitslice_do<bs64>(plaintext, ciphertext, rk, 0);
+}
+
+void sm4_bitslice::decryptBlocks64(const uint8_t* ciphertext, uint8_t* plaintext) const {
+    SM4_bitslice_do<bs64>(ciphertext, plaintext, rk, 1);
+}
+
+void sm4_bitslice::encryptBlocks128(const uint8_t* plaintext, uint8_t* ciphertext) const {
+    SM4_bitslice_do<bs128>(plaintext, ciphertext, rk, 0);
+}
+
+void sm4_bitslice::decryptBlocks128(const uint8_t* ciphertext, uint8_t* plaintext) const {
+    SM4_bitslice_do<bs128>(ciphertext, plaintext, rk, 1);
+}
+
+void sm4_bitslice::encryptBlocks256(const uint8_t* plaintext, uint8_t* ciphertext) const {
+    bs256_do(plaintext, ciphertext, rk, 0);
+}
+
+void sm4_bitslice::decryptBlocks256(const uint8_t* ciphertext, uint8_t* plaintext) const {
+    bs256_do(ciphertext, plaintext, rk, 1);
+}
+
+// Full 256-block (AVX2) or 128-block batches, then the narrowest width that
+// still covers the remainder so a short tail does not pay for 256 lanes.
+void sm4_bitslice::cryptBlocks(const uint8_t* in, uint8_t* out, size_t nblocks, int enc) const {
+    const bool wide = sm4_cpu().avx2;
+    size_t i = 0;
+    if (wide) {
+        for (; nblocks - i >= 256; i += 256)
+            bs256_do(in + 16 * i, out + 16 * i, rk, enc);
+    }
+    for (; nblocks - i >= 128; i += 128)
+        SM4_bitslice_do<bs128>(in + 16 * i, out + 16 * i, rk, enc);
+
+    size_t n = nblocks - i;
+    if (n == 0)
+        return;
+    if (n <= 64)
+        SM4_bitslice_do<bs64>(in + 16 * i, out + 16 * i, rk, enc, n);
+    else
+        SM4_bitslice_do<bs128>(in + 16 * i, out + 16 * i, rk, enc, n);
+}
+
+void sm4_bitslice::encryptBlocks(const uint8_t* in, uint8_t* out, size_t nblocks) const {
+    cryptBlocks(in, out, nblocks, 0);
+}
+
+void sm4_bitslice::decryptBlocks(const uint8_t* in, uint8_t* out, size_t nblocks) const {
+    cryptBlocks(in, out, nblocks, 1);
+}
+
+void sm4_bitslice::encryptBlock(const uint8_t in[16], uint8_t out[16]) const {
+    SM4_bitslice_do<bs64>(in, out, rk, 0, 1);
+}
+
+void sm4_bitslice::decryptBlock(const uint8_t in[16], uint8_t out[16]) const {
+    SM4_bitslice_do<bs64>(in, out, rk, 1, 1);
+}
@@ -0,0 +1,42 @@
+#pragma once
+#ifndef SM4_BITSLICE_H
+#define SM4_BITSLICE_H
+
+#include "sm4.h"
+
+// Note: no -m flags needed; the 256-block kernel carries target("avx2"), so
+// encryptBlocks256/decryptBlocks256 need an AVX2 CPU (GCC/Clang)
+
+// Bitsliced constant-time SM4: 64, 128 or 256 blocks are transposed into
+// 128 bit-planes (uint64_t, __m128i or __m256i), the S-box is evaluated as a
+// boolean circuit and L is a renaming of planes. No secret-indexed lookups,
+// also in the key schedule, and no AES-NI required.
+class sm4_bitslice : public sm4 {
+public:
+    sm4_bitslice() = default;
+
+    // key schedule with the circuit S-box instead of sm4::Sbox
+    void setKey(const uint8_t key[16]);
+
+    void encryptBlocks64(const uint8_t* plaintext, uint8_t* ciphertext) const;
+    void decryptBlocks64(const uint8_t* ciphertext, uint8_t* plaintext) const;
+
+    void encryptBlocks128(const uint8_t* plaintext, uint8_t* ciphertext) const;
+    void decryptBlocks128(const uint8_t* ciphertext, uint8_t* plaintext) const;
+
+    void encryptBlocks256(const uint8_t* plaintext, uint8_t* ciphertext) const;
+    void decryptBlocks256(const uint8_t* ciphertext, uint8_t* plaintext) const;
+
+    // single block through the 64-lane circuit, so no path falls back to sm4's table S-box
+    void encryptBlock(const uint8_t in[16], uint8_t out[16]) const;
+    void decryptBlock(const uint8_t in[16], uint8_t out[16]) const;
+
+    // any number of blocks; the last batch is packed with zero lanes
+    void encryptBlocks(const uint8_t* in, uint8_t* out, size_t nblocks) const;
+    void decryptBlocks(const uint8_t* in, uint8_t* out, size_t nblocks) const;
+
+private:
+    void cryptBlocks(const uint8_t* in, uint8_t* out, size_t nblocks, int enc) const;
+};
+
+#endif
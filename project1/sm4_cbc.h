@@ -0,0 +1,102 @@
+#pragma once
+#ifndef SM4_CBC_H
+#define SM4_CBC_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+// SM4-CBC over any backend with setKey, const encryptBlock and const
+// encryptBlocks/decryptBlocks (sm4, sm4_table, sm4_aesni, sm4_vaes, sm4_gfni,
+// sm4_bitslice).
+//
+// Decryption has no chain dependency: batches of ciphertext blocks go through
+// the backend's wide kernels and are then xored with the preceding
+// ciphertext. Encryption of one stream is inherently serial, so
+// encryptStreams() runs several independent streams side by side, one block
+// of each per call, to fill the vector lanes. Lengths are in bytes and must be
+// a multiple of 16 (no padding is applied); the functions return false
+// otherwise. in == out is allowed.
+template <class BlockCipher>
+class sm4_cbc {
+public:
+    // blocks per decryption batch and streams per encryption batch
+    static const size_t batch = 64;
+
+    void setKey(const uint8_t key[16]) { cipher.setKey(key); }
+
+    bool encrypt(const uint8_t iv[16], const uint8_t* in, uint8_t* out, size_t len) const {
+        if (len % 16)
+            return false;
+        const uint8_t* prev = iv;
+        uint8_t x[16];
+        for (size_t off = 0; off < len; off += 16) {
+            xor16(x, in + off, prev);
+            cipher.encryptBlock(x, out + off);
+            prev = out + off;
+        }
+        return true;
+    }
+
+    bool decrypt(const uint8_t iv[16], const uint8_t* in, uint8_t* out, size_t len) const {
+        if (len % 16)
+            return false;
+        uint8_t prev[16], next[16], buf[16 * batch];
+        std::memcpy(prev, iv, 16);
+        for (size_t off = 0; off < len; off += 16 * batch) {
+            size_t n = (len - off) / 16 < batch ? (len - off) / 16 : batch;
+            cipher.decryptBlocks(in + off, buf, n);
+            // the last ciphertext block chains into the next batch; save it
+            // before out (possibly == in) is overwritten
+            std::memcpy(next, in + off + 16 * (n - 1), 16);
+            for (size_t i = n - 1; i > 0; --i)
+                xor16(out + off + 16 * i, buf + 16 * i, in + off + 16 * (i - 1));
+            xor16(out + off, buf, prev);
+            std::memcpy(prev, next, 16);
+        }
+        return true;
+    }
+
+    // nstreams independent CBC streams under this key: stream s encrypts
+    // lens[s] bytes from in[s] to out[s] with ivs[s]. Streams may differ in length.
+    bool encryptStreams(const uint8_t* const ivs[], const uint8_t* const in[], uint8_t* const out[],
+        const size_t lens[], size_t nstreams) const {
+        for (size_t s = 0; s < nstreams; ++s)
+            if (lens[s] % 16)
+                return false;
+
+        uint8_t buf[16 * batch];
+        size_t active[batch];
+        for (size_t first = 0; first < nstreams; first += batch) {
+            size_t last = nstreams - first < batch ? nstreams : first + batch;
+            for (size_t off = 0;; off += 16) {
+                // gather block `off` of every stream that still has one
+                size_t n = 0;
+                for (size_t s = first; s < last; ++s) {
+                    if (off >= lens[s])
+                        continue;
+                    xor16(buf + 16 * n, in[s] + off, off == 0 ? ivs[s] : out[s] + off - 16);
+                    active[n++] = s;
+                }
+                if (n == 0)
+                    break;
+                cipher.encryptBlocks(buf, buf, n);
+                for (size_t i = 0; i < n; ++i)
+                    std::memcpy(out[active[i]] + off, buf + 16 * i, 16);
+            }
+        }
+        return true;
+    }
+
+    const BlockCipher& blockCipher() const { return cipher; }
+
+private:
+    BlockCipher cipher;
+
+    static inline void xor16(uint8_t* out, const uint8_t* a, const uint8_t* b) {
+        for (int i = 0; i < 16; ++i)
+            out[i] = a[i] ^ b[i];
+    }
+};
+
+#endif
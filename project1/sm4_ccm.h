@@ -0,0 +1,212 @@
+#pragma once
+#ifndef SM4_CCM_H
+#define SM4_CCM_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+// SM4-CCM (NIST SP 800-38C / RFC 3610, as used by RFC 8998 TLS_SM4_CCM_SM3)
+// over any backend with setKey, const encryptBlock and const encryptBlocks.
+//
+// CCM is CBC-MAC over the plaintext plus CTR encryption. The MAC chain is
+// serial, one block cipher call per block; the keystream is not. So the
+// counters are generated ahead: when the keystream buffer runs dry, the next
+// MAC block goes in lane 0 of one encryptBlocks call and the next batch - 1
+// counter blocks fill the other lanes; the MAC steps in between are
+// single-block calls. A multi-lane kernel (sm4_aesni, sm4_vaes, sm4_gfni, ...)
+// thus yields the keystream of many payload blocks for the price of one MAC
+// step. Batch should match the kernel width (32 for sm4_gfni, 16 for
+// sm4_vaes, 4 for sm4_aesni): a batch wider than the kernel costs the MAC
+// extra kernel calls. The MAC chain, one block latency per payload block,
+// still bounds the speed, well below that of GCM. When decrypting, the MAC
+// trails the keystream by one block, since the plaintext it authenticates is
+// only known after the xor.
+//
+// Nonce: 7..13 bytes; tag: 4, 6, ..., 16 bytes. encrypt/decrypt return false on
+// invalid parameters, decrypt also on a wrong tag (the output is then zeroed).
+// in == out is allowed.
+template <class BlockCipher, size_t Batch = 32>
+class sm4_ccm {
+public:
+    // blocks per encryptBlocks call: one MAC block and batch - 1 counters
+    static const size_t batch = Batch;
+
+    void setKey(const uint8_t key[16]) { cipher.setKey(key); }
+
+    bool encrypt(const uint8_t* nonce, size_t nonce_len,
+        const uint8_t* plaintext, size_t len,
+        const uint8_t* aad, size_t aad_len,
+        uint8_t* ciphertext, uint8_t* tag, size_t tag_len = 16) const {
+        uint8_t X[16], ctr[16], S0[16];
+        if (!start(nonce, nonce_len, len, aad, aad_len, tag_len, X, ctr, S0))
+            return false;
+
+        // lane 0: CBC-MAC, lanes 1..: counter blocks, ks: next unused keystream block
+        uint8_t buf[16 * batch];
+        const uint8_t* ks = buf;
+        size_t avail = 0;
+        for (size_t off = 0; off < len; off += 16) {
+            size_t n = len - off < 16 ? len - off : 16;
+            xor_bytes(X, plaintext + off, n);
+            if (avail == 0) {
+                std::memcpy(buf, X, 16);
+                avail = counters(buf + 16, ctr, nonce_len, batch - 1, len - off);
+                cipher.encryptBlocks(buf, buf, 1 + avail);
+                std::memcpy(X, buf, 16);
+                ks = buf + 16;
+            } else {
+                cipher.encryptBlock(X, X);
+            }
+            for (size_t i = 0; i < n; ++i)
+                ciphertext[off + i] = plaintext[off + i] ^ ks[i];
+            ks += 16;
+            --avail;
+        }
+        for (size_t i = 0; i < tag_len; ++i)
+            tag[i] = X[i] ^ S0[i];
+        return true;
+    }
+
+    bool decrypt(const uint8_t* nonce, size_t nonce_len,
+        const uint8_t* ciphertext, size_t len,
+        const uint8_t* aad, size_t aad_len,
+        const uint8_t* tag, size_t tag_len, uint8_t* plaintext) const {
+        uint8_t X[16], ctr[16], S0[16];
+        if (!start(nonce, nonce_len, len, aad, aad_len, tag_len, X, ctr, S0))
+            return false;
+
+        // lane 0: CBC-MAC of the previous plaintext block (none before the
+        // first one), then counter blocks; ks: next unused keystream block
+        uint8_t buf[16 * batch], prev[16];
+        const uint8_t* ks = buf;
+        size_t avail = 0, prev_len = 0;
+        for (size_t off = 0; off < len; off += 16) {
+            size_t n = len - off < 16 ? len - off : 16;
+            if (prev_len)
+                xor_bytes(X, prev, prev_len);
+            if (avail == 0) {
+                size_t lanes = prev_len ? 1 : 0;
+                std::memcpy(buf, X, 16);
+                avail = counters(buf + 16 * lanes, ctr, nonce_len, batch - lanes, len - off);
+                cipher.encryptBlocks(buf, buf, lanes + avail);
+                if (prev_len)
+                    std::memcpy(X, buf, 16);
+                ks = buf + 16 * lanes;
+            } else if (prev_len) {
+                cipher.encryptBlock(X, X);
+            }
+            for (size_t i = 0; i < n; ++i)
+                prev[i] = ciphertext[off + i] ^ ks[i];
+            std::memcpy(plaintext + off, prev, n);
+            prev_len = n;
+            ks += 16;
+            --avail;
+        }
+        if (prev_len) {
+            xor_bytes(X, prev, prev_len);
+            cipher.encryptBlock(X, X);
+        }
+
+        uint8_t diff = 0;
+        for (size_t i = 0; i < tag_len; ++i)
+            diff |= X[i] ^ S0[i] ^ tag[i];
+        if (diff) {
+            std::memset(plaintext, 0, len);
+            return false;
+        }
+        return true;
+    }
+
+    const BlockCipher& blockCipher() const { return cipher; }
+
+private:
+    BlockCipher cipher;
+
+    static inline void xor_bytes(uint8_t* out, const uint8_t* in, size_t n) {
+        for (size_t i = 0; i < n; ++i)
+            out[i] ^= in[i];
+    }
+
+    // increment the L = 15 - nonce_len byte counter field
+    static inline void inc(uint8_t ctr[16], size_t nonce_len) {
+        for (size_t i = 15; i > nonce_len; --i)
+            if (++ctr[i])
+                break;
+    }
+
+    // the next min(max, blocks left in rest bytes) counter blocks into out
+    static inline size_t counters(uint8_t* out, uint8_t ctr[16], size_t nonce_len, size_t max, size_t rest) {
+        size_t nb = (rest + 15) / 16 < max ? (rest + 15) / 16 : max;
+        for (size_t i = 0; i < nb; ++i) {
+            inc(ctr, nonce_len);
+            std::memcpy(out + 16 * i, ctr, 16);
+        }
+        return nb;
+    }
+
+    // B0 and the AAD through the MAC; X = MAC state, ctr = A0,
+    // S0 = E(A0) (the tag mask, computed in the same call as B0)
+    bool start(const uint8_t* nonce, size_t nonce_len, size_t len,
+        const uint8_t* aad, size_t aad_len, size_t tag_len,
+        uint8_t X[16], uint8_t ctr[16], uint8_t S0[16]) const {
+        if (nonce_len < 7 || nonce_len > 13 || tag_len < 4 || tag_len > 16 || (tag_len & 1))
+            return false;
+        const size_t L = 15 - nonce_len;
+        if (L < sizeof(size_t) && (uint64_t)len >> (8 * L))
+            return false;
+
+        uint8_t buf[32];
+        buf[0] = (uint8_t)((aad_len ? 0x40 : 0) | ((tag_len - 2) / 2) << 3 | (L - 1));
+        std::memcpy(buf + 1, nonce, nonce_len);
+        for (size_t i = 0; i < L; ++i)
+            buf[15 - i] = i < sizeof(size_t) ? (uint8_t)((uint64_t)len >> (8 * i)) : 0;
+
+        std::memset(ctr, 0, 16);
+        ctr[0] = (uint8_t)(L - 1);
+        std::memcpy(ctr + 1, nonce, nonce_len);
+        std::memcpy(buf + 16, ctr, 16);
+        cipher.encryptBlocks(buf, buf, 2);
+        std::memcpy(X, buf, 16);
+        std::memcpy(S0, buf + 16, 16);
+
+        if (aad_len == 0)
+            return true;
+
+        // length prefix of the associated data, then the data, zero padded
+        uint8_t block[16];
+        size_t used;
+        if (aad_len < 0xFF00) {
+            block[0] = (uint8_t)(aad_len >> 8);
+            block[1] = (uint8_t)aad_len;
+            used = 2;
+        } else if ((uint64_t)aad_len <= 0xFFFFFFFFu) {
+            block[0] = 0xFF;
+            block[1] = 0xFE;
+            for (int i = 0; i < 4; ++i)
+                block[2 + i] = (uint8_t)((uint64_t)aad_len >> (24 - 8 * i));
+            used = 6;
+        } else {
+            block[0] = 0xFF;
+            block[1] = 0xFF;
+            for (int i = 0; i < 8; ++i)
+                block[2 + i] = (uint8_t)((uint64_t)aad_len >> (56 - 8 * i));
+            used = 10;
+        }
+        size_t off = 0;
+        for (;;) {
+            size_t n = aad_len - off < 16 - used ? aad_len - off : 16 - used;
+            std::memcpy(block + used, aad + off, n);
+            std::memset(block + used + n, 0, 16 - used - n);
+            off += n;
+            xor_bytes(X, block, 16);
+            cipher.encryptBlock(X, X);
+            if (off == aad_len)
+                break;
+            used = 0;
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,190 @@
+#pragma once
+#ifndef SM4_CORE_H
+#define SM4_CORE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+
+// 256-entry lookup tables usable in constant expressions, so tables derived
+// from them are also built by the compiler and land in .rodata
+struct sm4_byte_table {
+    uint8_t v[256];
+    constexpr uint8_t operator[](size_t i) const { return v[i]; }
+};
+
+struct sm4_word_table {
+    uint32_t v[256];
+    constexpr uint32_t operator[](size_t i) const { return v[i]; }
+};
+
+// SM4 constants shared by the whole family (out-of-line definitions in sm4.cpp)
+struct sm4_consts {
+    static constexpr sm4_byte_table Sbox = { {
+        0xd6, 0x90, 0xe9, 0xfe, 0xcc, 0xe1, 0x3d, 0xb7,
+        0x16, 0xb6, 0x14, 0xc2, 0x28, 0xfb, 0x2c, 0x05,
+        0x2b, 0x67, 0x9a, 0x76, 0x2a, 0xbe, 0x04, 0xc3,
+        0xaa, 0x44, 0x13, 0x26, 0x49, 0x86, 0x06, 0x99,
+        0x9c, 0x42, 0x50, 0xf4, 0x91, 0xef, 0x98, 0x7a,
+        0x33, 0x54, 0x0b, 0x43, 0xed, 0xcf, 0xac, 0x62,
+        0xe4, 0xb3, 0x1c, 0xa9, 0xc9, 0x08, 0xe8, 0x95,
+        0x80, 0xdf, 0x94, 0xfa, 0x75, 0x8f, 0x3f, 0xa6,
+        0x47, 0x07, 0xa7, 0xfc, 0xf3, 0x73, 0x17, 0xba,
+        0x83, 0x59, 0x3c, 0x19, 0xe6, 0x85, 0x4f, 0xa8,
+        0x68, 0x6b, 0x81, 0xb2, 0x71, 0x64, 0xda, 0x8b,
+        0xf8, 0xeb, 0x0f, 0x4b, 0x70, 0x56, 0x9d, 0x35,
+        0x1e, 0x24, 0x0e, 0x5e, 0x63, 0x58, 0xd1, 0xa2,
+        0x25, 0x22, 0x7c, 0x3b, 0x01, 0x21, 0x78, 0x87,
+        0xd4, 0x00, 0x46, 0x57, 0x9f, 0xd3, 0x27, 0x52,
+        0x4c, 0x36, 0x02, 0xe7, 0xa0, 0xc4, 0xc8, 0x9e,
+        0xea, 0xbf, 0x8a, 0xd2, 0x40, 0xc7, 0x38, 0xb5,
+        0xa3, 0xf7, 0xf2, 0xce, 0xf9, 0x61, 0x15, 0xa1,
+        0xe0, 0xae, 0x5d, 0xa4, 0x9b, 0x34, 0x1a, 0x55,
+        0xad, 0x93, 0x32, 0x30, 0xf5, 0x8c, 0xb1, 0xe3,
+        0x1d, 0xf6, 0xe2, 0x2e, 0x82, 0x66, 0xca, 0x60,
+        0xc0, 0x29, 0x23, 0xab, 0x0d, 0x53, 0x4e, 0x6f,
+        0xd5, 0xdb, 0x37, 0x45, 0xde, 0xfd, 0x8e, 0x2f,
+        0x03, 0xff, 0x6a, 0x72, 0x6d, 0x6c, 0x5b, 0x51,
+        0x8d, 0x1b, 0xaf, 0x92, 0xbb, 0xdd, 0xbc, 0x7f,
+        0x11, 0xd9, 0x5c, 0x41, 0x1f, 0x10, 0x5a, 0xd8,
+        0x0a, 0xc1, 0x31, 0x88, 0xa5, 0xcd, 0x7b, 0xbd,
+        0x2d, 0x74, 0xd0, 0x12, 0xb8, 0xe5, 0xb4, 0xb0,
+        0x89, 0x69, 0x97, 0x4a, 0x0c, 0x96, 0x77, 0x7e,
+        0x65, 0xb9, 0xf1, 0x09, 0xc5, 0x6e, 0xc6, 0x84,
+        0x18, 0xf0, 0x7d, 0xec, 0x3a, 0xdc, 0x4d, 0x20,
+        0x79, 0xee, 0x5f, 0x3e, 0xd7, 0xcb, 0x39, 0x48
+    } };
+    static const uint32_t FK[4];
+    static const uint32_t CK[32];
+};
+
+// Everything derived from one key, computed once and shared (sm4_key_cache):
+// the schedule in encryption and decryption order, the same round keys
+// broadcast to 128 bits for the SIMD kernels, and the GCM hash subkey.
+struct sm4_expanded_key {
+    uint8_t key[16];
+    uint32_t rk[32];
+    uint32_t rk_rev[32];
+    alignas(16) uint32_t rk_x4[32][4];
+    alignas(16) uint32_t rk_rev_x4[32][4];
+    uint8_t H[16];          // E_K(0^128)
+};
+
+static constexpr uint32_t sm4_rotl(uint32_t x, int n) {
+    return (x << n) | (x >> (32 - n));
+}
+
+// ---------------- round-function policies ----------------
+// SboxPolicy::tau(x) is the nonlinear step of T, LinearPolicy::L(x) the linear
+// one. A policy that already folds L into its lookups pairs with sm4_linear_none.
+
+struct sm4_sbox_bytes {
+    static inline uint32_t tau(uint32_t x) {
+        return ((uint32_t)sm4_consts::Sbox[(x >> 24) & 0xff] << 24) |
+            ((uint32_t)sm4_consts::Sbox[(x >> 16) & 0xff] << 16) |
+            ((uint32_t)sm4_consts::Sbox[(x >> 8) & 0xff] << 8) |
+            (uint32_t)sm4_consts::Sbox[x & 0xff];
+    }
+};
+
+struct sm4_linear_rotl {
+    static constexpr uint32_t L(uint32_t x) {
+        return x ^ sm4_rotl(x, 2) ^ sm4_rotl(x, 10) ^ sm4_rotl(x, 18) ^ sm4_rotl(x, 24);
+    }
+};
+
+struct sm4_linear_none {
+    static inline uint32_t L(uint32_t x) { return x; }
+};
+
+// ---------------- round pipeline ----------------
+
+// The 32 rounds are unrolled at compile time: round R uses rk[R] (rk[31 - R]
+// when decrypting) as a constant offset, and the four state words rotate
+// through registers instead of an X[36] array. Variants differ only in the
+// policies, so nothing in the rounds is dispatched at run time.
+template <class SboxPolicy, class LinearPolicy>
+class sm4_core {
+public:
+    void setKey(const uint8_t key[16]) {
+        expandKey(key, rk);
+    }
+
+    // the 32 round keys of key, encryption order
+    static void expandKey(const uint8_t key[16], uint32_t out[32]) {
+        uint32_t K[4];
+        for (int i = 0; i < 4; ++i)
+            K[i] = load32(key + 4 * i) ^ sm4_consts::FK[i];
+
+        for (int i = 0; i < 32; ++i) {
+            uint32_t tmp = sm4_sbox_bytes::tau(K[(i + 1) & 3] ^ K[(i + 2) & 3] ^ K[(i + 3) & 3] ^ sm4_consts::CK[i]);
+            tmp = tmp ^ sm4_rotl(tmp, 13) ^ sm4_rotl(tmp, 23);
+            out[i] = K[i & 3] ^= tmp;
+        }
+    }
+
+    // reuse a schedule from sm4_key_cache instead of expanding the key again
+    void setExpandedKey(const sm4_expanded_key& xk) {
+        for (int i = 0; i < 32; ++i)
+            rk[i] = xk.rk[i];
+    }
+
+    void encryptBlock(const uint8_t in[16], uint8_t out[16]) const {
+        crypt<false>(in, out, rk);
+    }
+
+    void decryptBlock(const uint8_t in[16], uint8_t out[16]) const {
+        crypt<true>(in, out, rk);
+    }
+
+    // nblocks consecutive 16-byte blocks, ECB
+    void encryptBlocks(const uint8_t* in, uint8_t* out, size_t nblocks) const {
+        for (size_t i = 0; i < nblocks; ++i)
+            crypt<false>(in + 16 * i, out + 16 * i, rk);
+    }
+
+    void decryptBlocks(const uint8_t* in, uint8_t* out, size_t nblocks) const {
+        for (size_t i = 0; i < nblocks; ++i)
+            crypt<true>(in + 16 * i, out + 16 * i, rk);
+    }
+
+protected:
+    uint32_t rk[32];
+
+    static inline uint32_t T(uint32_t x) {
+        return LinearPolicy::L(SboxPolicy::tau(x));
+    }
+
+    static inline uint32_t load32(const uint8_t* p) {
+        return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+    }
+
+    static inline void store32(uint8_t* p, uint32_t v) {
+        p[0] = (uint8_t)(v >> 24); p[1] = (uint8_t)(v >> 16); p[2] = (uint8_t)(v >> 8); p[3] = (uint8_t)v;
+    }
+
+    template <bool Dec>
+    static inline void crypt(const uint8_t in[16], uint8_t out[16], const uint32_t* rk) {
+        uint32_t x0 = load32(in), x1 = load32(in + 4), x2 = load32(in + 8), x3 = load32(in + 12);
+        rounds<Dec>(x0, x1, x2, x3, rk, std::integral_constant<int, 0>());
+        store32(out, x3); store32(out + 4, x2); store32(out + 8, x1); store32(out + 12, x0);
+    }
+
+private:
+    template <bool Dec, int R>
+    static inline void rounds(uint32_t& x0, uint32_t& x1, uint32_t& x2, uint32_t& x3,
+        const uint32_t* rk, std::integral_constant<int, R>) {
+        x0 ^= T(x1 ^ x2 ^ x3 ^ rk[Dec ? 31 - R : R]);
+        x1 ^= T(x2 ^ x3 ^ x0 ^ rk[Dec ? 30 - R : R + 1]);
+        x2 ^= T(x3 ^ x0 ^ x1 ^ rk[Dec ? 29 - R : R + 2]);
+        x3 ^= T(x0 ^ x1 ^ x2 ^ rk[Dec ? 28 - R : R + 3]);
+        rounds<Dec>(x0, x1, x2, x3, rk, std::integral_constant<int, R + 4>());
+    }
+
+    template <bool Dec>
+    static inline void rounds(uint32_t&, uint32_t&, uint32_t&, uint32_t&,
+        const uint32_t*, std::integral_constant<int, 32>) {
+    }
+};
+
+#endif
@@ -0,0 +1,165 @@
+#include "sm4_engine.h"
+#include "sm4.h"
+#include "sm4_table.h"
+#include "sm4_aesni.h"
+#include "sm4_vaes.h"
+#include "sm4_gfni.h"
+#include "sm4_bitslice.h"
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+// ---------------- CPU probing ----------------
+
+static void cpuid(int leaf, int sub, uint32_t r[4]) {
+#if defined(_MSC_VER)
+    int regs[4];
+    __cpuidex(regs, leaf, sub);
+    for (int i = 0; i < 4; ++i) r[i] = (uint32_t)regs[i];
+#else
+    __cpuid_count(leaf, sub, r[0], r[1], r[2], r[3]);
+#endif
+}
+
+static uint64_t xgetbv0() {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    uint32_t lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((uint64_t)hi << 32) | lo;
+#endif
+}
+
+static sm4_cpu_features probe() {
+    sm4_cpu_features f;
+    uint32_t r[4];
+    cpuid(0, 0, r);
+    uint32_t max_leaf = r[0];
+
+    cpuid(1, 0, r);
+    f.ssse3 = (r[2] >> 9) & 1;
+    f.pclmul = (r[2] >> 1) & 1;
+    f.aesni = (r[2] >> 25) & 1;
+    bool osxsave = (r[2] >> 27) & 1;
+    bool avx = (r[2] >> 28) & 1;
+
+    // the OS has to save YMM (XCR0 bits 1,2) / ZMM (bits 5,6,7) state
+    uint64_t xcr0 = osxsave ? xgetbv0() : 0;
+    bool os_ymm = avx && (xcr0 & 0x6) == 0x6;
+    bool os_zmm = os_ymm && (xcr0 & 0xe0) == 0xe0;
+
+    if (max_leaf >= 7) {
+        cpuid(7, 0, r);
+        f.avx2 = os_ymm && ((r[1] >> 5) & 1);
+        f.avx512f = os_zmm && ((r[1] >> 16) & 1);
+        f.avx512bw = os_zmm && ((r[1] >> 30) & 1);
+        f.gfni = (r[2] >> 8) & 1;
+        f.vaes = os_ymm && ((r[2] >> 9) & 1);
+        f.vpclmulqdq = os_ymm && ((r[2] >> 10) & 1);
+    }
+    return f;
+}
+
+const sm4_cpu_features& sm4_cpu() {
+    static const sm4_cpu_features features = probe();
+    return features;
+}
+
+// ---------------- backends ----------------
+
+namespace {
+
+// Every backend has a const bulk encryptBlocks/decryptBlocks that handles any
+// block count itself, so one adapter covers all of them.
+template <class Cipher>
+class engine_bulk : public sm4_engine {
+public:
+    explicit engine_bulk(const char* n) : id(n) {}
+    void setKey(const uint8_t key[16]) override { c.setKey(key); }
+    void setExpandedKey(const sm4_expanded_key& xk) override { c.setExpandedKey(xk); }
+    void encryptBlocks(const uint8_t* in, uint8_t* out, size_t n) const override { c.encryptBlocks(in, out, n); }
+    void decryptBlocks(const uint8_t* in, uint8_t* out, size_t n) const override { c.decryptBlocks(in, out, n); }
+    const char* name() const override { return id; }
+    Cipher& cipher() { return c; }
+private:
+    Cipher c;
+    const char* id;
+};
+
+sm4_engine* make_gfni(unsigned bits) {
+    engine_bulk<sm4_gfni>* e = new engine_bulk<sm4_gfni>(bits == 512 ? "gfni512" : bits == 256 ? "gfni256" : "gfni128");
+    e->cipher().setWidth(bits);
+    return e;
+}
+
+struct backend_entry {
+    const char* name;
+    bool (*supported)(const sm4_cpu_features&);
+    sm4_engine* (*make)();
+};
+
+// fastest first
+const backend_entry backends[] = {
+    { "gfni512",
+      [](const sm4_cpu_features& f) { return f.gfni && f.avx512f && f.avx512bw; },
+      []() -> sm4_engine* { return make_gfni(512); } },
+    { "gfni256",
+      [](const sm4_cpu_features& f) { return f.gfni && f.avx2; },
+      []() -> sm4_engine* { return make_gfni(256); } },
+    { "vaes",
+      [](const sm4_cpu_features& f) { return f.vaes && f.aesni && f.avx2; },
+      []() -> sm4_engine* { return new engine_bulk<sm4_vaes>("vaes"); } },
+    { "gfni128",
+      [](const sm4_cpu_features& f) { return f.gfni && f.ssse3; },
+      []() -> sm4_engine* { return make_gfni(128); } },
+    { "aesni",
+      [](const sm4_cpu_features& f) { return f.aesni && f.ssse3; },
+      []() -> sm4_engine* { return new engine_bulk<sm4_aesni>("aesni"); } },
+    { "bitslice",
+      [](const sm4_cpu_features&) { return true; },
+      []() -> sm4_engine* { return new engine_bulk<sm4_bitslice>("bitslice"); } },
+    { "table",
+      [](const sm4_cpu_features&) { return true; },
+      []() -> sm4_engine* { return new engine_bulk<sm4_table>("table"); } },
+    { "table1k",
+      [](const sm4_cpu_features&) { return true; },
+      []() -> sm4_engine* { return new engine_bulk<sm4_table_compact>("table1k"); } },
+    { "ref",
+      [](const sm4_cpu_features&) { return true; },
+      []() -> sm4_engine* { return new engine_bulk<sm4>("ref"); } },
+};
+
+} // namespace
+
+std::unique_ptr<sm4_engine> sm4_engine::create(const char* name) {
+    for (const backend_entry& b : backends)
+        if (std::strcmp(b.name, name) == 0 && b.supported(sm4_cpu()))
+            return std::unique_ptr<sm4_engine>(b.make());
+    return nullptr;
+}
+
+std::unique_ptr<sm4_engine> sm4_engine::create() {
+    const char* forced = std::getenv("SM4_ENGINE");
+    if (forced != nullptr) {
+        std::unique_ptr<sm4_engine> e = create(forced);
+        if (e) return e;
+    }
+    for (const backend_entry& b : backends)
+        if (b.supported(sm4_cpu()))
+            return std::unique_ptr<sm4_engine>(b.make());
+    return nullptr;
+}
+
+std::vector<const char*> sm4_engine::available() {
+    std::vector<const char*> names;
+    for (const backend_entry& b : backends)
+        if (b.supported(sm4_cpu()))
+            names.push_back(b.name);
+    return names;
+}
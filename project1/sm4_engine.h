@@ -0,0 +1,69 @@
+#pragma once
+#ifndef SM4_ENGINE_H
+#define SM4_ENGINE_H
+
+#include "sm4_core.h"
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// CPU features relevant to the SM4 backends, probed once (CPUID + XGETBV)
+struct sm4_cpu_features {
+    bool ssse3 = false;
+    bool aesni = false;
+    bool pclmul = false;
+    bool avx2 = false;
+    bool vaes = false;
+    bool gfni = false;
+    bool vpclmulqdq = false;
+    bool avx512f = false;
+    bool avx512bw = false;
+};
+
+const sm4_cpu_features& sm4_cpu();
+
+// Kernels that need more than the baseline x86-64 ISA name it per function,
+// so every file builds without -m flags and a wide kernel's encodings never
+// leak into the narrower fallbacks next to it; sm4_cpu() decides which
+// kernels run. SM4_FLATTEN inlines a whole call tree (templates included)
+// into such a kernel.
+#if defined(__GNUC__)
+#define SM4_TARGET(isa) __attribute__((target(isa)))
+#define SM4_FLATTEN __attribute__((flatten))
+#else
+#define SM4_TARGET(isa)
+#define SM4_FLATTEN
+#endif
+
+// One bulk interface over all SM4 implementations.
+//
+// sm4_engine::create() picks the fastest backend the CPU supports:
+//   gfni512 > gfni256 > vaes > gfni128 > aesni > bitslice > table
+// (table1k and ref are only picked by name)
+// Setting the environment variable SM4_ENGINE to a backend name (see
+// sm4_engine::available()) forces that backend, e.g. SM4_ENGINE=aesni for
+// benchmarking. Unknown or unsupported names fall back to the automatic choice.
+class sm4_engine {
+public:
+    virtual ~sm4_engine() = default;
+
+    virtual void setKey(const uint8_t key[16]) = 0;
+    // schedule from sm4_key_cache, skips the key expansion
+    virtual void setExpandedKey(const sm4_expanded_key& xk) = 0;
+
+    // n blocks of 16 bytes, any n
+    virtual void encryptBlocks(const uint8_t* in, uint8_t* out, size_t n) const = 0;
+    virtual void decryptBlocks(const uint8_t* in, uint8_t* out, size_t n) const = 0;
+
+    virtual const char* name() const = 0;
+
+    static std::unique_ptr<sm4_engine> create();
+    // nullptr if the name is unknown or the CPU lacks the instructions
+    static std::unique_ptr<sm4_engine> create(const char* name);
+
+    // backends usable on this CPU, fastest first
+    static std::vector<const char*> available();
+};
+
+#endif
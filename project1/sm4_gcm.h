@@ -0,0 +1,187 @@
+#pragma once
+#ifndef SM4_GCM_H
+#define SM4_GCM_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+// SM4-GCM over any block cipher backend (setKey, const encryptBlock and const
+// bulk encryptBlocks: sm4, sm4_table, sm4_aesni, sm4_vaes, sm4_gfni,
+// sm4_bitslice, ...) and any GHASH with init(H) and const
+// update(Y, data, nblocks): ghash_bitwise, ghash_table, ghash_clmul.
+//
+//   sm4_gcm<sm4_gfni, ghash_clmul> g;
+//   g.setKey(key);
+//   g.seal(iv, 12, pt, len, aad, aad_len, ct, tag);
+//   ok = g.open(iv, 12, ct, len, aad, aad_len, tag, pt);
+//
+// The CTR step hands `batch` counter blocks at a time to the backend's bulk
+// encryptBlocks, so a 16- or 32-lane kernel always sees full groups. The
+// GHASH of one batch runs between two kernel calls, as in sm4_gcm_simd: when
+// encrypting it covers the ciphertext of the previous batch, when decrypting
+// the input of the current one (read before out, possibly == in, is written).
+// open() hashes the ciphertext and compares the tag in constant time before
+// the CTR pass, so a forged message costs only its GHASH and plaintext is
+// written only when the tag matches; open_fused() is the single stitched pass
+// for large trusted input and zeroes the plaintext on a mismatch.
+// seal/open are const; one keyed object serves any number of messages and
+// threads. A GHASH needing parameters is passed in ready-made, e.g.
+// sm4_gcm<sm4_table, ghash_table> g(ghash_table(8)).
+template <class BlockCipher, class GHash>
+class sm4_gcm {
+public:
+    // blocks per CTR kernel call
+    static const size_t batch = 32;
+
+    sm4_gcm() = default;
+    explicit sm4_gcm(const GHash& g) : gh(g) {}
+
+    void setKey(const uint8_t key[16]) {
+        cipher.setKey(key);
+        uint8_t H[16] = { 0 };
+        cipher.encryptBlock(H, H);
+        gh.init(H);
+    }
+
+    void seal(const uint8_t* iv, size_t iv_len,
+        const uint8_t* plaintext, size_t len,
+        const uint8_t* aad, size_t aad_len,
+        uint8_t* ciphertext, uint8_t tag[16]) const {
+        uint8_t j0[16], Y[16] = { 0 };
+        init_j0(iv, iv_len, j0);
+        hash_padded(Y, aad, aad_len);
+        ctr_hash(j0, Y, plaintext, len, ciphertext, seal_pass);
+        finish(j0, Y, aad_len, len, tag);
+    }
+
+    bool open(const uint8_t* iv, size_t iv_len,
+        const uint8_t* ciphertext, size_t len,
+        const uint8_t* aad, size_t aad_len,
+        const uint8_t tag[16], uint8_t* plaintext) const {
+        uint8_t j0[16], Y[16] = { 0 };
+        init_j0(iv, iv_len, j0);
+        hash_padded(Y, aad, aad_len);
+        hash_padded(Y, ciphertext, len);
+        if (!tag_equal(j0, Y, aad_len, len, tag))
+            return false;
+        ctr_hash(j0, Y, ciphertext, len, plaintext, ctr_pass);
+        return true;
+    }
+
+    bool open_fused(const uint8_t* iv, size_t iv_len,
+        const uint8_t* ciphertext, size_t len,
+        const uint8_t* aad, size_t aad_len,
+        const uint8_t tag[16], uint8_t* plaintext) const {
+        uint8_t j0[16], Y[16] = { 0 };
+        init_j0(iv, iv_len, j0);
+        hash_padded(Y, aad, aad_len);
+        ctr_hash(j0, Y, ciphertext, len, plaintext, open_pass);
+        if (tag_equal(j0, Y, aad_len, len, tag))
+            return true;
+        std::memset(plaintext, 0, len);
+        return false;
+    }
+
+    const BlockCipher& blockCipher() const { return cipher; }
+    const GHash& ghash() const { return gh; }
+
+private:
+    BlockCipher cipher;
+    GHash gh;
+
+    // seal_pass/open_pass: CTR stitched with GHASH; ctr_pass: keystream only
+    enum pass { seal_pass, open_pass, ctr_pass };
+
+    static inline void inc32(uint8_t block[16]) {
+        for (int i = 15; i >= 12; --i)
+            if (++block[i])
+                break;
+    }
+
+    static inline void put_be64(uint8_t* p, uint64_t v) {
+        for (int i = 0; i < 8; ++i)
+            p[i] = static_cast<uint8_t>(v >> (56 - 8 * i));
+    }
+
+    // len bytes, the last block zero padded
+    void hash_padded(uint8_t Y[16], const uint8_t* data, size_t len) const {
+        gh.update(Y, data, len / 16);
+        if (len % 16) {
+            uint8_t last[16] = { 0 };
+            std::memcpy(last, data + len / 16 * 16, len % 16);
+            gh.update(Y, last, 1);
+        }
+    }
+
+    // J0 = IV || 0^31 || 1 for 96-bit IVs, else GHASH(IV || 0-pad || [0]64 || [len(IV)]64)
+    void init_j0(const uint8_t* iv, size_t iv_len, uint8_t j0[16]) const {
+        if (iv_len == 12) {
+            std::memcpy(j0, iv, 12);
+            j0[12] = 0x00; j0[13] = 0x00; j0[14] = 0x00; j0[15] = 0x01;
+            return;
+        }
+        std::memset(j0, 0, 16);
+        hash_padded(j0, iv, iv_len);
+        uint8_t len_block[16] = { 0 };
+        put_be64(len_block + 8, static_cast<uint64_t>(iv_len) * 8);
+        gh.update(j0, len_block, 1);
+    }
+
+    void ctr_hash(const uint8_t j0[16], uint8_t Y[16], const uint8_t* in, size_t len, uint8_t* out, pass p) const {
+        const bool enc = p == seal_pass;
+        uint8_t ctrs[16 * batch], ks[16 * batch], counter[16];
+        std::memcpy(counter, j0, 16);
+        inc32(counter);
+        const uint8_t* pending = nullptr;
+        size_t pending_blocks = 0;
+
+        for (size_t off = 0; off < len; off += 16 * batch) {
+            size_t bytes = len - off < 16 * batch ? len - off : 16 * batch;
+            size_t nb = (bytes + 15) / 16;
+            for (size_t i = 0; i < nb; ++i) {
+                std::memcpy(ctrs + 16 * i, counter, 16);
+                inc32(counter);
+            }
+            cipher.encryptBlocks(ctrs, ks, nb);
+            if (p == open_pass)
+                hash_padded(Y, in + off, bytes);
+            else if (enc && pending)
+                gh.update(Y, pending, pending_blocks);
+            for (size_t i = 0; i < bytes; ++i)
+                out[off + i] = in[off + i] ^ ks[i];
+            pending = out + off;
+            pending_blocks = nb;
+            if (enc && bytes % 16) {
+                hash_padded(Y, pending, bytes);
+                pending = nullptr;
+            }
+        }
+        if (enc && pending)
+            gh.update(Y, pending, pending_blocks);
+    }
+
+    // length block, then tag = GHASH ^ E(K, J0)
+    void finish(const uint8_t j0[16], uint8_t Y[16], size_t aad_len, size_t ct_len, uint8_t tag[16]) const {
+        uint8_t len_block[16];
+        put_be64(len_block, static_cast<uint64_t>(aad_len) * 8);
+        put_be64(len_block + 8, static_cast<uint64_t>(ct_len) * 8);
+        gh.update(Y, len_block, 1);
+        uint8_t Ek0[16];
+        cipher.encryptBlock(j0, Ek0);
+        for (int i = 0; i < 16; ++i)
+            tag[i] = Y[i] ^ Ek0[i];
+    }
+
+    // constant-time comparison of the tag finished from Y with tag
+    bool tag_equal(const uint8_t j0[16], uint8_t Y[16], size_t aad_len, size_t ct_len, const uint8_t tag[16]) const {
+        uint8_t computed[16];
+        finish(j0, Y, aad_len, ct_len, computed);
+        uint8_t diff = 0;
+        for (int i = 0; i < 16; ++i)
+            diff |= computed[i] ^ tag[i];
+        return diff == 0;
+    }
+};
+
+#endif
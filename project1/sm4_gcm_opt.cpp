@@ -3,30 +3,46 @@
 
 constexpr size_t BLOCK_SIZE = 16;
 
-sm4_gcm_opt::sm4_gcm_opt(const uint8_t key[16], const uint8_t* iv, size_t iv_len) {
+sm4_gcm_opt::sm4_gcm_opt(const uint8_t key[16], int table_bits) : gh(table_bits) {
     cipher.setKey(key);
 
     uint8_t zero[BLOCK_SIZE] = { 0 };
     cipher.encryptBlock(zero, H);
+    gh.init(H);
+}
+
+// Schedule and H come precomputed from sm4_key_cache
+sm4_gcm_opt::sm4_gcm_opt(const sm4_expanded_key& xk, int table_bits) : gh(table_bits) {
+    cipher.setExpandedKey(xk);
+    std::memcpy(H, xk.H, BLOCK_SIZE);
+    gh.init(H);
+}
+
+sm4_gcm_opt::sm4_gcm_opt(const uint8_t key[16], const uint8_t* iv, size_t iv_len, int table_bits)
+    : sm4_gcm_opt(key, table_bits) {
+    init_j0(iv, iv_len, J0);
+}
 
+sm4_gcm_opt::sm4_gcm_opt(const sm4_expanded_key& xk, const uint8_t* iv, size_t iv_len, int table_bits)
+    : sm4_gcm_opt(xk, table_bits) {
+    init_j0(iv, iv_len, J0);
+}
+
+void sm4_gcm_opt::init_j0(const uint8_t* iv, size_t iv_len, uint8_t j0[16]) const {
     if (iv_len == 12) {
-        std::memcpy(J0, iv, 12);
-        J0[12] = 0; J0[13] = 0; J0[14] = 0; J0[15] = 1;
+        std::memcpy(j0, iv, 12);
+        j0[12] = 0; j0[13] = 0; j0[14] = 0; j0[15] = 1;
     }
     else {
         uint8_t S[BLOCK_SIZE] = { 0 };
         size_t blocks = iv_len / BLOCK_SIZE;
         size_t rem = iv_len % BLOCK_SIZE;
 
-        for (size_t i = 0; i < blocks; ++i) {
-            xor_block(S, iv + i * BLOCK_SIZE);
-            gmul(S, H);
-        }
+        gh.update(S, iv, blocks);
         if (rem) {
             uint8_t last[BLOCK_SIZE] = { 0 };
             std::memcpy(last, iv + blocks * BLOCK_SIZE, rem);
-            xor_block(S, last);
-            gmul(S, H);
+            gh.update(S, last, 1);
         }
 
         uint8_t len_block[BLOCK_SIZE] = { 0 };
@@ -36,12 +52,10 @@ sm4_gcm_opt::sm4_gcm_opt(const uint8_t key[16], const uint8_t* iv, size_t iv_len
             iv_bits >>= 8;
         }
 
-        xor_block(S, len_block);
-        gmul(S, H);
+        gh.update(S, len_block, 1);
 
-        std::memcpy(J0, S, BLOCK_SIZE);
+        std::memcpy(j0, S, BLOCK_SIZE);
     }
-    std::memcpy(counter, J0, BLOCK_SIZE);
 }
 
 inline void sm4_gcm_opt::xor_block(uint8_t out[16], const uint8_t in[16]) {
@@ -57,28 +71,10 @@ inline void sm4_gcm_opt::inc32(uint8_t block[16]) {
     }
 }
 
-inline void sm4_gcm_opt::gmul(uint8_t X[16], const uint8_t Y[16]) {
-    uint8_t Z[16] = { 0 };
-    uint8_t V[16];
-    std::memcpy(V, Y, BLOCK_SIZE);
-
-    for (int i = 0; i < 128; ++i) {
-        int bit = (X[i / 8] >> (7 - (i % 8))) & 1;
-        if (bit) {
-            for (int j = 0; j < 16; ++j)
-                Z[j] ^= V[j];
-        }
-        bool lsb = (V[15] & 1) != 0;
-        for (int j = 15; j > 0; --j)
-            V[j] = (V[j] >> 1) | ((V[j - 1] & 1) << 7);
-        V[0] >>= 1;
-        if (lsb) V[0] ^= 0xe1;
-    }
-    std::memcpy(X, Z, BLOCK_SIZE);
-}
-
-void sm4_gcm_opt::encrypt_ctr(const uint8_t* input, size_t len, uint8_t* output) {
-    uint8_t keystream[BLOCK_SIZE];
+void sm4_gcm_opt::encrypt_ctr(const uint8_t j0[16], const uint8_t* input, size_t len, uint8_t* output) const {
+    uint8_t counter[BLOCK_SIZE], keystream[BLOCK_SIZE];
+    std::memcpy(counter, j0, BLOCK_SIZE);
+    inc32(counter);
 
     size_t blocks = len / BLOCK_SIZE;
     size_t rem = len % BLOCK_SIZE;
@@ -99,33 +95,25 @@ void sm4_gcm_opt::encrypt_ctr(const uint8_t* input, size_t len, uint8_t* output)
 
 void sm4_gcm_opt::ghash(const uint8_t* aad, size_t aad_len,
     const uint8_t* ct, size_t ct_len,
-    uint8_t tag[16]) {
+    uint8_t tag[16]) const {
     uint8_t Y[BLOCK_SIZE] = { 0 };
 
     size_t aad_blocks = aad_len / BLOCK_SIZE;
     size_t aad_rem = aad_len % BLOCK_SIZE;
-    for (size_t i = 0; i < aad_blocks; ++i) {
-        xor_block(Y, aad + i * BLOCK_SIZE);
-        gmul(Y, H);
-    }
+    gh.update(Y, aad, aad_blocks);
     if (aad_rem) {
         uint8_t last[BLOCK_SIZE] = { 0 };
         std::memcpy(last, aad + aad_blocks * BLOCK_SIZE, aad_rem);
-        xor_block(Y, last);
-        gmul(Y, H);
+        gh.update(Y, last, 1);
     }
 
     size_t ct_blocks = ct_len / BLOCK_SIZE;
     size_t ct_rem = ct_len % BLOCK_SIZE;
-    for (size_t i = 0; i < ct_blocks; ++i) {
-        xor_block(Y, ct + i * BLOCK_SIZE);
-        gmul(Y, H);
-    }
+    gh.update(Y, ct, ct_blocks);
     if (ct_rem) {
         uint8_t last[BLOCK_SIZE] = { 0 };
         std::memcpy(last, ct + ct_blocks * BLOCK_SIZE, ct_rem);
-        xor_block(Y, last);
-        gmul(Y, H);
+        gh.update(Y, last, 1);
     }
 
     uint8_t len_block[BLOCK_SIZE] = { 0 };
@@ -136,45 +124,72 @@ void sm4_gcm_opt::ghash(const uint8_t* aad, size_t aad_len,
         len_block[15 - i] = static_cast<uint8_t>((ct_bits >> (i * 8)) & 0xff);
     }
 
-    xor_block(Y, len_block);
-    gmul(Y, H);
+    gh.update(Y, len_block, 1);
 
     std::memcpy(tag, Y, BLOCK_SIZE);
 }
 
+void sm4_gcm_opt::seal(const uint8_t* iv, size_t iv_len,
+    const uint8_t* plaintext, size_t len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext, uint8_t tag[16]) const {
+    uint8_t j0[BLOCK_SIZE];
+    init_j0(iv, iv_len, j0);
+    seal_j0(j0, plaintext, len, aad, aad_len, ciphertext, tag);
+}
+
+bool sm4_gcm_opt::open(const uint8_t* iv, size_t iv_len,
+    const uint8_t* ciphertext, size_t len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t tag[16], uint8_t* plaintext) const {
+    uint8_t j0[BLOCK_SIZE];
+    init_j0(iv, iv_len, j0);
+    return open_j0(j0, ciphertext, len, aad, aad_len, tag, plaintext);
+}
+
 void sm4_gcm_opt::encrypt(const uint8_t* plaintext, size_t len,
     const uint8_t* aad, size_t aad_len,
     uint8_t* ciphertext, uint8_t tag[16]) {
-    std::memcpy(counter, J0, BLOCK_SIZE);
-    inc32(counter);
+    seal_j0(J0, plaintext, len, aad, aad_len, ciphertext, tag);
+}
+
+bool sm4_gcm_opt::decrypt(const uint8_t* ciphertext, size_t len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t tag[16], uint8_t* plaintext) {
+    return open_j0(J0, ciphertext, len, aad, aad_len, tag, plaintext);
+}
 
-    encrypt_ctr(plaintext, len, ciphertext);
+void sm4_gcm_opt::seal_j0(const uint8_t j0[16], const uint8_t* plaintext, size_t len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext, uint8_t tag[16]) const {
+    encrypt_ctr(j0, plaintext, len, ciphertext);
 
     ghash(aad, aad_len, ciphertext, len, tag);
 
     uint8_t Ek0[BLOCK_SIZE];
-    cipher.encryptBlock(J0, Ek0);
+    cipher.encryptBlock(j0, Ek0);
     xor_block(tag, Ek0);
 }
 
-bool sm4_gcm_opt::decrypt(const uint8_t* ciphertext, size_t len,
+// verify first: the tag over the ciphertext is checked in constant time and
+// the keystream pass runs only for an authentic message (ciphertext == plaintext works)
+bool sm4_gcm_opt::open_j0(const uint8_t j0[16], const uint8_t* ciphertext, size_t len,
     const uint8_t* aad, size_t aad_len,
-    const uint8_t tag[16], uint8_t* plaintext) {
-    std::memcpy(counter, J0, BLOCK_SIZE);
-    inc32(counter);
-
-    encrypt_ctr(ciphertext, len, plaintext);
-
+    const uint8_t tag[16], uint8_t* plaintext) const {
     uint8_t computed_tag[BLOCK_SIZE];
     ghash(aad, aad_len, ciphertext, len, computed_tag);
 
     uint8_t Ek0[BLOCK_SIZE];
-    cipher.encryptBlock(J0, Ek0);
+    cipher.encryptBlock(j0, Ek0);
     xor_block(computed_tag, Ek0);
 
     uint8_t diff = 0;
     for (int i = 0; i < 16; ++i) {
         diff |= (computed_tag[i] ^ tag[i]);
     }
-    return diff == 0;
-}
\ No newline at end of file
+    if (diff)
+        return false;
+
+    encrypt_ctr(j0, ciphertext, len, plaintext);
+    return true;
+}
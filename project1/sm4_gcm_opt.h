@@ -3,11 +3,31 @@
 #include <cstdint>
 #include <cstddef>
 #include "sm4.h"
+#include "sm4_ghash_table.h"
 
+// GHASH uses per-key Shoup tables (no PCLMULQDQ needed): table_bits = 4 for a
+// 256-byte table, 8 for a 4 KiB table with half the lookups per block.
+// As in sm4gcm, a key-only object serves any number of seal()/open() calls,
+// concurrently if need be; the tables are built once per key. open()/decrypt()
+// verify the tag before decrypting and leave plaintext untouched on failure.
 class sm4_gcm_opt {
 public:
-    sm4_gcm_opt(const uint8_t key[16], const uint8_t* iv, size_t iv_len);
+    explicit sm4_gcm_opt(const uint8_t key[16], int table_bits = 4);
+    explicit sm4_gcm_opt(const sm4_expanded_key& xk, int table_bits = 4);
+    sm4_gcm_opt(const uint8_t key[16], const uint8_t* iv, size_t iv_len, int table_bits = 4);
+    sm4_gcm_opt(const sm4_expanded_key& xk, const uint8_t* iv, size_t iv_len, int table_bits = 4);
 
+    void seal(const uint8_t* iv, size_t iv_len,
+        const uint8_t* plaintext, size_t len,
+        const uint8_t* aad, size_t aad_len,
+        uint8_t* ciphertext, uint8_t tag[16]) const;
+
+    bool open(const uint8_t* iv, size_t iv_len,
+        const uint8_t* ciphertext, size_t len,
+        const uint8_t* aad, size_t aad_len,
+        const uint8_t tag[16], uint8_t* plaintext) const;
+
+    // use the IV given to the constructor
     void encrypt(const uint8_t* plaintext, size_t len,
         const uint8_t* aad, size_t aad_len,
         uint8_t* ciphertext, uint8_t tag[16]);
@@ -18,16 +38,22 @@ public:
 
 private:
     sm4 cipher;
-    uint8_t H[16];        // Hash subkey
-    uint8_t J0[16];       // Pre-counter block
-    uint8_t counter[16];  // Current counter
+    uint8_t H[16];          // Hash subkey
+    uint8_t J0[16] = {};    // Pre-counter block of the constructor IV
+    ghash_table gh;         // multiples of H
 
+    void init_j0(const uint8_t* iv, size_t iv_len, uint8_t j0[16]) const;
+    void seal_j0(const uint8_t j0[16], const uint8_t* plaintext, size_t len,
+        const uint8_t* aad, size_t aad_len,
+        uint8_t* ciphertext, uint8_t tag[16]) const;
+    bool open_j0(const uint8_t j0[16], const uint8_t* ciphertext, size_t len,
+        const uint8_t* aad, size_t aad_len,
+        const uint8_t tag[16], uint8_t* plaintext) const;
     void ghash(const uint8_t* aad, size_t aad_len,
         const uint8_t* ct, size_t ct_len,
-        uint8_t tag[16]);
+        uint8_t tag[16]) const;
 
-    inline void gmul(uint8_t X[16], const uint8_t Y[16]);
-    inline void xor_block(uint8_t out[16], const uint8_t in[16]);
-    inline void inc32(uint8_t block[16]);
-    void encrypt_ctr(const uint8_t* input, size_t len, uint8_t* output);
+    static inline void xor_block(uint8_t out[16], const uint8_t in[16]);
+    static inline void inc32(uint8_t block[16]);
+    void encrypt_ctr(const uint8_t j0[16], const uint8_t* input, size_t len, uint8_t* output) const;
 };
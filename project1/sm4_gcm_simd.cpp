@@ -1,5 +1,6 @@
 #include "sm4_gcm_simd.h"
 #include <cstring>
+#include <vector>
 #include <emmintrin.h>
 #include <tmmintrin.h> // _mm_shuffle_epi8
 #include <smmintrin.h>
@@ -19,191 +20,455 @@ inline __m128i sm4_gcm_simd::xor128(__m128i a, __m128i b) {
     return _mm_xor_si128(a, b);
 }
 
-/*
-  ghash_multiply: full CLMUL product + reduction
-  This follows the algorithmic sequence shown in Intel whitepaper (Figures 5/7),
-  which yields an exact 128-bit result equivalent to canonical software GF(2^128) product
-  reduced modulo x^128 + x^7 + x^2 + x + 1.
-*/
-inline __m128i sm4_gcm_simd::ghash_multiply(__m128i a, __m128i b) {
-    // carry-less multiply parts
-    __m128i tmp3 = _mm_clmulepi64_si128(a, b, 0x00); // a_lo * b_lo
-    __m128i tmp4 = _mm_clmulepi64_si128(a, b, 0x10); // a_hi * b_lo
-    __m128i tmp5 = _mm_clmulepi64_si128(a, b, 0x01); // a_lo * b_hi
-    __m128i tmp6 = _mm_clmulepi64_si128(a, b, 0x11); // a_hi * b_hi
-
-    // combine middle parts
-    tmp4 = _mm_xor_si128(tmp4, tmp5);   // middle combined
-
-    // fold middle into low/high 128-bit halves
-    __m128i t_lo = _mm_slli_si128(tmp4, 8); // middle << 64
-    __m128i t_hi = _mm_srli_si128(tmp4, 8); // middle >> 64
-
-    tmp3 = _mm_xor_si128(tmp3, t_lo);   // low 128 bits
-    tmp6 = _mm_xor_si128(tmp6, t_hi);   // high 128 bits
-
-    // Now tmp6: high 128 bits, tmp3: low 128 bits -> 256-bit product = (tmp6,tmp3)
-
-    // Begin reduction (two-phase) as in Intel paper:
-    // Phase 1: bit-manipulation and alignment
-    __m128i tmp7 = _mm_srli_epi32(tmp3, 31);
-    __m128i tmp8 = _mm_srli_epi32(tmp6, 31);
-
-    tmp3 = _mm_slli_epi32(tmp3, 1);
-    tmp6 = _mm_slli_epi32(tmp6, 1);
-
-    __m128i tmp9 = _mm_srli_si128(tmp7, 12);
-    tmp8 = _mm_slli_si128(tmp8, 4);
-    tmp7 = _mm_slli_si128(tmp7, 4);
-
-    tmp3 = _mm_or_si128(tmp3, tmp7);
-    tmp6 = _mm_or_si128(tmp6, tmp8);
-    tmp6 = _mm_or_si128(tmp6, tmp9);
-
-    // Phase 2: more folding for reduction
-    __m128i t7 = _mm_slli_epi32(tmp3, 31);
-    __m128i t8 = _mm_slli_epi32(tmp3, 30);
-    __m128i t9 = _mm_slli_epi32(tmp3, 25);
-
-    t7 = _mm_xor_si128(t7, t8);
-    t7 = _mm_xor_si128(t7, t9);
-
-    __m128i t8_shifted = _mm_srli_si128(t7, 4);
-    t7 = _mm_slli_si128(t7, 12);
-
-    tmp3 = _mm_xor_si128(tmp3, t7);
-
-    __m128i tmp2 = _mm_srli_epi32(tmp3, 1);
-    __m128i tmp4_2 = _mm_srli_epi32(tmp3, 2);
-    __m128i tmp5_2 = _mm_srli_epi32(tmp3, 7);
-
-    tmp2 = _mm_xor_si128(tmp2, tmp4_2);
-    tmp2 = _mm_xor_si128(tmp2, tmp5_2);
-    tmp2 = _mm_xor_si128(tmp2, t8_shifted);
-
-    tmp3 = _mm_xor_si128(tmp3, tmp2);
-
-    tmp6 = _mm_xor_si128(tmp6, tmp3);
+sm4_gcm_simd::sm4_gcm_simd(const uint8_t key[16]) {
+    cipher.setKey(key);
 
-    // tmp6 now holds the reduced 128-bit result
-    return tmp6;
+    uint8_t zero[BLOCK_SIZE] = { 0 };
+    cipher.encryptBlock(zero, H);
+    gh.init(H);
+    Hchunk = gh.power(sm4_parallel_chunk_blocks);
 }
 
+// Schedule and H come precomputed from sm4_key_cache
+sm4_gcm_simd::sm4_gcm_simd(const sm4_expanded_key& xk) {
+    cipher.setExpandedKey(xk);
+    std::memcpy(H, xk.H, BLOCK_SIZE);
+    gh.init(H);
+    Hchunk = gh.power(sm4_parallel_chunk_blocks);
+}
 
-sm4_gcm_simd::sm4_gcm_simd(const uint8_t key[16], const uint8_t* iv, size_t iv_len) {
-    cipher.setKey(key);
+sm4_gcm_simd::sm4_gcm_simd(const uint8_t key[16], const uint8_t* iv, size_t iv_len) : sm4_gcm_simd(key) {
+    init_j0(iv, iv_len, J0);
+}
 
-    uint8_t zero[BLOCK_SIZE] = { 0 };
-    cipher.encryptBlock(zero, H);
+sm4_gcm_simd::sm4_gcm_simd(const sm4_expanded_key& xk, const uint8_t* iv, size_t iv_len) : sm4_gcm_simd(xk) {
+    init_j0(iv, iv_len, J0);
+}
 
+// other IV lengths: J0 = GHASH(IV || 0-pad || [0]64 || [len(IV)]64)
+void sm4_gcm_simd::init_j0(const uint8_t* iv, size_t iv_len, uint8_t j0[16]) const {
     if (iv_len == 12) {
-        std::memcpy(J0, iv, 12);
-        J0[12] = 0x00; J0[13] = 0x00; J0[14] = 0x00; J0[15] = 0x01;
+        std::memcpy(j0, iv, 12);
+        j0[12] = 0x00; j0[13] = 0x00; j0[14] = 0x00; j0[15] = 0x01;
     }
     else {
-        uint8_t S[BLOCK_SIZE] = { 0 };
-        size_t blocks = iv_len / BLOCK_SIZE;
-        size_t rem = iv_len % BLOCK_SIZE;
-        for (size_t i = 0; i < blocks; ++i) {
-            xor_block(S, iv + i * BLOCK_SIZE);
-            gmul(S, H);
-        }
-        if (rem) {
-            uint8_t last[BLOCK_SIZE] = { 0 };
-            std::memcpy(last, iv + blocks * BLOCK_SIZE, rem);
-            xor_block(S, last);
-            gmul(S, H);
-        }
-
+        __m128i s = ghash_update(_mm_setzero_si128(), iv, iv_len);
         uint8_t len_block[BLOCK_SIZE] = { 0 };
         uint64_t iv_bits = static_cast<uint64_t>(iv_len) * 8;
         for (int i = 0; i < 8; ++i) {
             len_block[15 - i] = static_cast<uint8_t>(iv_bits & 0xff);
             iv_bits >>= 8;
         }
-        xor_block(S, len_block);
-        gmul(S, H);
-        std::memcpy(J0, S, BLOCK_SIZE);
+        s = gh.update(s, len_block, 1);
+        ghash_clmul::store_state(s, j0);
     }
-    std::memcpy(counter, J0, BLOCK_SIZE);
 }
 
-void sm4_gcm_simd::encrypt(const uint8_t* plaintext, size_t len,
+void sm4_gcm_simd::seal(const uint8_t* iv, size_t iv_len,
+    const uint8_t* plaintext, size_t len,
     const uint8_t* aad, size_t aad_len,
-    uint8_t* ciphertext, uint8_t tag[16]) {
-    std::memcpy(counter, J0, BLOCK_SIZE);
-    inc32(counter);
+    uint8_t* ciphertext, uint8_t tag[16]) const {
+    uint8_t j0[BLOCK_SIZE];
+    init_j0(iv, iv_len, j0);
+    seal_j0(j0, plaintext, len, aad, aad_len, ciphertext, tag);
+}
 
-    encrypt_ctr(plaintext, len, ciphertext);
-    ghash(aad, aad_len, ciphertext, len, tag);
+void sm4_gcm_simd::seal_parallel(const uint8_t* iv, size_t iv_len,
+    const uint8_t* plaintext, size_t len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext, uint8_t tag[16], sm4_thread_pool& pool) const {
+    uint8_t j0[BLOCK_SIZE];
+    init_j0(iv, iv_len, j0);
+    __m128i y = ghash_update(_mm_setzero_si128(), aad, aad_len);
+    y = ctr_ghash_parallel(j0, y, plaintext, len, ciphertext, seal_pass, pool);
+    finish_tag(j0, y, aad_len, len, tag);
+}
 
-    uint8_t Ek0[BLOCK_SIZE];
-    cipher.encryptBlock(J0, Ek0);
-    xor_block(tag, Ek0);
+bool sm4_gcm_simd::open_parallel(const uint8_t* iv, size_t iv_len,
+    const uint8_t* ciphertext, size_t len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t tag[16], uint8_t* plaintext, sm4_thread_pool& pool) const {
+    uint8_t j0[BLOCK_SIZE];
+    init_j0(iv, iv_len, j0);
+    __m128i y = ghash_update(_mm_setzero_si128(), aad, aad_len);
+    y = ctr_ghash_parallel(j0, y, ciphertext, len, plaintext, hash_pass, pool);
+    if (!tag_equal(j0, y, aad_len, len, tag))
+        return false;
+    ctr_ghash_parallel(j0, y, ciphertext, len, plaintext, ctr_pass, pool);
+    return true;
+}
+
+bool sm4_gcm_simd::open_parallel_fused(const uint8_t* iv, size_t iv_len,
+    const uint8_t* ciphertext, size_t len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t tag[16], uint8_t* plaintext, sm4_thread_pool& pool) const {
+    uint8_t j0[BLOCK_SIZE];
+    init_j0(iv, iv_len, j0);
+    __m128i y = ghash_update(_mm_setzero_si128(), aad, aad_len);
+    y = ctr_ghash_parallel(j0, y, ciphertext, len, plaintext, open_pass, pool);
+    if (tag_equal(j0, y, aad_len, len, tag))
+        return true;
+    std::memset(plaintext, 0, len);
+    return false;
+}
+
+bool sm4_gcm_simd::open(const uint8_t* iv, size_t iv_len,
+    const uint8_t* ciphertext, size_t len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t tag[16], uint8_t* plaintext) const {
+    uint8_t j0[BLOCK_SIZE];
+    init_j0(iv, iv_len, j0);
+    return open_j0(j0, ciphertext, len, aad, aad_len, tag, plaintext);
+}
+
+bool sm4_gcm_simd::open_fused(const uint8_t* iv, size_t iv_len,
+    const uint8_t* ciphertext, size_t len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t tag[16], uint8_t* plaintext) const {
+    uint8_t j0[BLOCK_SIZE], ctr[BLOCK_SIZE];
+    init_j0(iv, iv_len, j0);
+    counter_at(j0, 0, ctr);
+    __m128i y = ghash_update(_mm_setzero_si128(), aad, aad_len);
+    y = ctr_ghash(ctr, y, ciphertext, len, plaintext, open_pass);
+    if (tag_equal(j0, y, aad_len, len, tag))
+        return true;
+    std::memset(plaintext, 0, len);
+    return false;
+}
+
+void sm4_gcm_simd::encrypt(const uint8_t* plaintext, size_t len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext, uint8_t tag[16]) {
+    seal_j0(J0, plaintext, len, aad, aad_len, ciphertext, tag);
 }
 
 bool sm4_gcm_simd::decrypt(const uint8_t* ciphertext, size_t len,
     const uint8_t* aad, size_t aad_len,
     const uint8_t tag[16], uint8_t* plaintext) {
-    std::memcpy(counter, J0, BLOCK_SIZE);
-    inc32(counter);
+    return open_j0(J0, ciphertext, len, aad, aad_len, tag, plaintext);
+}
 
-    encrypt_ctr(ciphertext, len, plaintext);
+void sm4_gcm_simd::seal_j0(const uint8_t j0[16], const uint8_t* plaintext, size_t len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext, uint8_t tag[16]) const {
+    uint8_t ctr[BLOCK_SIZE];
+    counter_at(j0, 0, ctr);
+    __m128i y = ghash_update(_mm_setzero_si128(), aad, aad_len);
+    y = ctr_ghash(ctr, y, plaintext, len, ciphertext, seal_pass);
+    finish_tag(j0, y, aad_len, len, tag);
+}
 
-    uint8_t computed_tag[BLOCK_SIZE];
-    ghash(aad, aad_len, ciphertext, len, computed_tag);
+bool sm4_gcm_simd::open_j0(const uint8_t j0[16], const uint8_t* ciphertext, size_t len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t tag[16], uint8_t* plaintext) const {
+    // GHASH alone (several GB/s) rejects forged input before any SM4 work;
+    // plaintext is only written for an authentic message
+    __m128i y = ghash_update(_mm_setzero_si128(), aad, aad_len);
+    y = ghash_update(y, ciphertext, len);
+    if (!tag_equal(j0, y, aad_len, len, tag))
+        return false;
+    uint8_t ctr[BLOCK_SIZE];
+    counter_at(j0, 0, ctr);
+    ctr_ghash(ctr, y, ciphertext, len, plaintext, ctr_pass);
+    return true;
+}
 
-    uint8_t Ek0[BLOCK_SIZE];
-    cipher.encryptBlock(J0, Ek0);
-    xor_block(computed_tag, Ek0);
+// Full blocks go through ghash_clmul eight at a time; the accumulator
+// stays in a register from the first AAD block to the length block.
+__m128i sm4_gcm_simd::ghash_update(__m128i y, const uint8_t* data, size_t len) const {
+    size_t blocks = len / BLOCK_SIZE;
+    y = gh.update(y, data, blocks);
+    if (len % BLOCK_SIZE) {
+        uint8_t last[BLOCK_SIZE] = { 0 };
+        std::memcpy(last, data + blocks * BLOCK_SIZE, len % BLOCK_SIZE);
+        y = gh.update(y, last, 1);
+    }
+    return y;
+}
 
-    uint8_t diff = 0;
-    for (int i = 0; i < 16; ++i) diff |= (computed_tag[i] ^ tag[i]);
-    return diff == 0;
+/*
+  ctr_ghash: one pass of CTR + GHASH, 16 blocks (256 bytes) per iteration.
+  The keystream of batch i (four 4-lane SM4 kernel calls) and the GHASH of a
+  ciphertext batch (one VPCLMULQDQ iteration, or two 8-block PCLMULQDQ
+  iterations, each reduced once) do not depend on each other, so the
+  out-of-order core runs the SM4 S-boxes and the CLMULs side by side. When
+  encrypting, the GHASH in iteration i covers the ciphertext of batch i-1,
+  which is already written; when decrypting it covers the input of batch i,
+  read before the output (possibly the same buffer) is written. hash_pass
+  only hashes the input, ctr_pass only applies the keystream (y returned as is).
+*/
+__m128i sm4_gcm_simd::ctr_ghash(const uint8_t ctr[16], __m128i y, const uint8_t* in, size_t len, uint8_t* out, pass p) const {
+    if (p == hash_pass)
+        return ghash_update(y, in, len);
+    const bool enc = p == seal_pass;
+    const size_t nb_batch = ghash_clmul::wide_stride;
+    const size_t batch = nb_batch * BLOCK_SIZE;
+    uint8_t ctrs[batch], ks[batch], counter[BLOCK_SIZE];
+    std::memcpy(counter, ctr, BLOCK_SIZE);
+    const uint8_t* pending = nullptr;
+    size_t off = 0;
+
+    for (; len - off >= batch; off += batch) {
+        for (size_t i = 0; i < nb_batch; ++i) {
+            std::memcpy(ctrs + i * BLOCK_SIZE, counter, BLOCK_SIZE);
+            inc32(counter);
+        }
+        cipher.encryptBlocks8(ctrs, ks);
+        cipher.encryptBlocks8(ctrs + batch / 2, ks + batch / 2);
+        if (p == open_pass)
+            y = gh.update(y, in + off, nb_batch);
+        else if (enc && pending)
+            y = gh.update(y, pending, nb_batch);
+        for (size_t i = 0; i < batch; i += BLOCK_SIZE)
+            store128(out + off + i, xor128(load128(in + off + i), load128(ks + i)));
+        pending = out + off;
+    }
+    if (enc && pending)
+        y = gh.update(y, pending, nb_batch);
+
+    // tail below one batch
+    size_t rest = len - off;
+    if (rest) {
+        size_t nb = (rest + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        for (size_t i = 0; i < nb; ++i) {
+            std::memcpy(ctrs + i * BLOCK_SIZE, counter, BLOCK_SIZE);
+            inc32(counter);
+        }
+        cipher.encryptBlocks(ctrs, ks, nb);
+        if (p == open_pass)
+            y = ghash_update(y, in + off, rest);
+        for (size_t i = 0; i < rest; ++i)
+            out[off + i] = in[off + i] ^ ks[i];
+        if (enc)
+            y = ghash_update(y, out + off, rest);
+    }
+    return y;
+}
+
+/*
+  ctr_ghash_parallel: chunk k (blocks [kC, kC + C), C = sm4_parallel_chunk_blocks)
+  starts its counter at J0 + 1 + kC and hashes its ciphertext from zero into
+  part[k]. With y the AAD hash, the serial GHASH state after the ciphertext is
+    (...((y * H^C ^ part[0]) * H^C ^ part[1]) ...) * H^last ^ part[m-1]
+  where last is the block count of the final chunk; one multiply per 16 KiB
+  chunk, done by the calling thread once the workers are finished.
+*/
+__m128i sm4_gcm_simd::ctr_ghash_parallel(const uint8_t j0[16], __m128i y, const uint8_t* in, size_t len, uint8_t* out,
+    pass p, sm4_thread_pool& pool) const {
+    const size_t chunk = sm4_parallel_chunk_blocks;
+    const size_t nblocks = (len + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    if (nblocks <= chunk || pool.size() == 1) {
+        uint8_t ctr[BLOCK_SIZE];
+        counter_at(j0, 0, ctr);
+        return ctr_ghash(ctr, y, in, len, out, p);
+    }
+
+    // partial hashes, byte-reflected, one 16-byte slot per chunk
+    std::vector<uint8_t> part((nblocks + chunk - 1) / chunk * BLOCK_SIZE);
+    pool.run(nblocks, chunk, [&](size_t b, size_t e) {
+        uint8_t ctr[BLOCK_SIZE];
+        counter_at(j0, b, ctr);
+        size_t off = b * BLOCK_SIZE, bytes = (e * BLOCK_SIZE < len ? e * BLOCK_SIZE : len) - off;
+        store128(&part[b / chunk * BLOCK_SIZE], ctr_ghash(ctr, _mm_setzero_si128(), in + off, bytes, out + off, p));
+    });
+    if (p == ctr_pass)
+        return y;
+
+    const size_t m = part.size() / BLOCK_SIZE;
+    for (size_t k = 0; k + 1 < m; ++k)
+        y = xor128(ghash_clmul::mul(y, Hchunk), load128(&part[k * BLOCK_SIZE]));
+    const size_t last = nblocks - (m - 1) * chunk;
+    return xor128(ghash_clmul::mul(y, last == chunk ? Hchunk : gh.power(last)), load128(&part[(m - 1) * BLOCK_SIZE]));
+}
+
+// Group capacity in blocks: keystream (data blocks + one J0 block per record)
+// and GHASH input (padded AAD + padded C + length block per record)
+static const size_t batch_ks_blocks = 256;
+static const size_t batch_gh_blocks = 320;
+
+static inline size_t blocks_of(size_t len) {
+    return (len + BLOCK_SIZE - 1) / BLOCK_SIZE;
 }
 
-void sm4_gcm_simd::encrypt_ctr(const uint8_t* input, size_t len, uint8_t* output) {
-    uint8_t keystream[BLOCK_SIZE];
-    for (size_t i = 0; i < len; i += BLOCK_SIZE) {
-        cipher.encryptBlock(counter, keystream);
-        size_t block_size = (i + BLOCK_SIZE <= len) ? BLOCK_SIZE : (len - i);
-        for (size_t j = 0; j < block_size; ++j) output[i + j] = input[i + j] ^ keystream[j];
-        inc32(counter);
+static inline void put_lengths(uint8_t block[16], size_t aad_len, size_t ct_len) {
+    uint64_t aad_bits = static_cast<uint64_t>(aad_len) * 8;
+    uint64_t ct_bits = static_cast<uint64_t>(ct_len) * 8;
+    for (int i = 0; i < 8; ++i) {
+        block[7 - i] = static_cast<uint8_t>((aad_bits >> (i * 8)) & 0xff);
+        block[15 - i] = static_cast<uint8_t>((ct_bits >> (i * 8)) & 0xff);
     }
 }
 
-void sm4_gcm_simd::ghash(const uint8_t* aad, size_t aad_len,
-    const uint8_t* ct, size_t ct_len,
-    uint8_t tag[16]) {
-    uint8_t Y[BLOCK_SIZE] = { 0 };
+// out = in ^ keystream k over one record
+static inline void xor_keystream(const sm4_gcm_record& m, const uint8_t* k) {
+    size_t i = 0;
+    for (; i + BLOCK_SIZE <= m.len; i += BLOCK_SIZE)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(m.out + i),
+            _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(m.in + i)),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(k + i))));
+    for (; i < m.len; ++i)
+        m.out[i] = m.in[i] ^ k[i];
+}
 
-    // process AAD
-    size_t blocks = (aad_len) / BLOCK_SIZE;
-    for (size_t i = 0; i < blocks; ++i) {
-        xor_block(Y, aad + i * BLOCK_SIZE);
-        gmul(Y, H);
+/*
+  Sealing: the J0 and counter blocks of the whole group go through the kernel
+  in one call, the records are encrypted, then their ciphertexts hashed.
+  Opening hashes the input first and needs only E(K, J0) for the tags; the
+  counters of the records that verified are then compacted and encrypted in
+  one call. A forged record costs its GHASH and one SM4 block, and its
+  output is not written.
+*/
+void sm4_gcm_simd::crypt_group(const sm4_gcm_record* recs, size_t n, bool* ok) const {
+    if (n == 0)
+        return;
+    alignas(16) uint8_t ks[batch_ks_blocks * BLOCK_SIZE];
+    alignas(16) uint8_t gin[batch_gh_blocks * BLOCK_SIZE];
+    alignas(16) uint8_t ek0[batch_ks_blocks * BLOCK_SIZE];
+    size_t ks_off[batch_ks_blocks], gh_off[batch_ks_blocks];
+    const bool enc = ok == nullptr;
+
+    // J0 of every record followed by its counter blocks
+    size_t nk = 0, ng = 0;
+    for (size_t r = 0; r < n; ++r) {
+        uint8_t* p = ks + nk * BLOCK_SIZE;
+        init_j0(recs[r].iv, recs[r].iv_len, p);
+        size_t nb = blocks_of(recs[r].len);
+        // an empty record has only J0; it may end a full group, so write no counter
+        if (nb)
+            counter_at(p, 0, p + BLOCK_SIZE);
+        for (size_t i = 1; i < nb; ++i) {
+            std::memcpy(p + (i + 1) * BLOCK_SIZE, p + i * BLOCK_SIZE, BLOCK_SIZE);
+            inc32(p + (i + 1) * BLOCK_SIZE);
+        }
+        ks_off[r] = nk;
+        gh_off[r] = ng;
+        nk += nb + 1;
+        ng += blocks_of(recs[r].aad_len) + nb + 1;
     }
-    if (aad_len % BLOCK_SIZE) {
-        uint8_t last[BLOCK_SIZE] = { 0 };
-        std::memcpy(last, aad + blocks * BLOCK_SIZE, aad_len % BLOCK_SIZE);
-        xor_block(Y, last);
-        gmul(Y, H);
+    if (enc)
+        cipher.encryptBlocks(ks, ks, nk);
+    for (size_t r = 0; r < n; ++r)
+        std::memcpy(ek0 + r * BLOCK_SIZE, ks + ks_off[r] * BLOCK_SIZE, BLOCK_SIZE);
+    if (!enc)
+        cipher.encryptBlocks(ek0, ek0, n);
+
+    // GHASH input AAD || 0-pad || C || 0-pad || lengths
+    std::memset(gin, 0, ng * BLOCK_SIZE);
+    for (size_t r = 0; r < n; ++r) {
+        const sm4_gcm_record& m = recs[r];
+        uint8_t* g = gin + gh_off[r] * BLOCK_SIZE;
+        if (m.aad_len)
+            std::memcpy(g, m.aad, m.aad_len);
+        g += blocks_of(m.aad_len) * BLOCK_SIZE;
+        if (enc)
+            xor_keystream(m, ks + (ks_off[r] + 1) * BLOCK_SIZE);
+        if (m.len)
+            std::memcpy(g, enc ? m.out : m.in, m.len);
+        put_lengths(g + blocks_of(m.len) * BLOCK_SIZE, m.aad_len, m.len);
     }
 
-    // process ciphertext
-    blocks = ct_len / BLOCK_SIZE;
-    for (size_t i = 0; i < blocks; ++i) {
-        xor_block(Y, ct + i * BLOCK_SIZE);
-        gmul(Y, H);
+    // independent GHASH chains, ghash_clmul::stride records at a time
+    for (size_t r0 = 0; r0 < n; r0 += ghash_clmul::stride) {
+        size_t lanes = n - r0 < ghash_clmul::stride ? n - r0 : ghash_clmul::stride;
+        __m128i y[ghash_clmul::stride];
+        const uint8_t* data[ghash_clmul::stride];
+        size_t nblocks[ghash_clmul::stride];
+        for (size_t l = 0; l < lanes; ++l) {
+            const sm4_gcm_record& m = recs[r0 + l];
+            y[l] = _mm_setzero_si128();
+            data[l] = gin + gh_off[r0 + l] * BLOCK_SIZE;
+            nblocks[l] = blocks_of(m.aad_len) + blocks_of(m.len) + 1;
+        }
+        gh.update_lanes(y, data, nblocks, lanes);
+        for (size_t l = 0; l < lanes; ++l) {
+            uint8_t t[BLOCK_SIZE];
+            ghash_clmul::store_state(y[l], t);
+            xor_block(t, ek0 + (r0 + l) * BLOCK_SIZE);
+            if (enc) {
+                std::memcpy(recs[r0 + l].tag, t, BLOCK_SIZE);
+                continue;
+            }
+            uint8_t diff = 0;
+            for (int i = 0; i < 16; ++i) diff |= (t[i] ^ recs[r0 + l].tag[i]);
+            ok[r0 + l] = diff == 0;
+        }
     }
-    if (ct_len % BLOCK_SIZE) {
-        uint8_t last[BLOCK_SIZE] = { 0 };
-        std::memcpy(last, ct + blocks * BLOCK_SIZE, ct_len % BLOCK_SIZE);
-        xor_block(Y, last);
-        gmul(Y, H);
+    if (enc)
+        return;
+
+    // keystream for the verified records only
+    size_t nv = 0;
+    for (size_t r = 0; r < n; ++r) {
+        if (!ok[r])
+            continue;
+        size_t nb = blocks_of(recs[r].len);
+        std::memmove(ks + nv * BLOCK_SIZE, ks + (ks_off[r] + 1) * BLOCK_SIZE, nb * BLOCK_SIZE);
+        ks_off[r] = nv;
+        nv += nb;
+    }
+    cipher.encryptBlocks(ks, ks, nv);
+    for (size_t r = 0; r < n; ++r)
+        if (ok[r])
+            xor_keystream(recs[r], ks + ks_off[r] * BLOCK_SIZE);
+}
+
+// Records [r, end) fill one group: cut before the first that would overflow
+// the keystream or GHASH buffer. end == r: record r alone is too large.
+static size_t group_end(const sm4_gcm_record* recs, size_t r, size_t n) {
+    size_t nk = 0, ng = 0;
+    for (; r < n; ++r) {
+        size_t k = blocks_of(recs[r].len) + 1, h = blocks_of(recs[r].aad_len) + k;
+        if (nk + k > batch_ks_blocks || ng + h > batch_gh_blocks)
+            break;
+        nk += k;
+        ng += h;
     }
+    return r;
+}
 
-    // length block (AAD bits || CT bits), big-endian 64-bit each
+void sm4_gcm_simd::seal_batch(const sm4_gcm_record* recs, size_t n) const {
+    size_t r = 0;
+    while (r < n) {
+        size_t g = group_end(recs, r, n);
+        if (g == r) {
+            const sm4_gcm_record& m = recs[r];
+            seal(m.iv, m.iv_len, m.in, m.len, m.aad, m.aad_len, m.out, m.tag);
+            ++r;
+            continue;
+        }
+        crypt_group(recs + r, g - r, nullptr);
+        r = g;
+    }
+}
+
+bool sm4_gcm_simd::open_batch(const sm4_gcm_record* recs, size_t n, bool* ok) const {
+    bool v[batch_ks_blocks];
+    bool all = true;
+    size_t r = 0;
+    while (r < n) {
+        size_t g = group_end(recs, r, n);
+        if (g == r) {
+            const sm4_gcm_record& m = recs[r];
+            v[0] = open(m.iv, m.iv_len, m.in, m.len, m.aad, m.aad_len, m.tag, m.out);
+            if (ok)
+                ok[r] = v[0];
+            all = all && v[0];
+            ++r;
+            continue;
+        }
+        crypt_group(recs + r, g - r, v);
+        for (size_t i = r; i < g; ++i) {
+            if (ok)
+                ok[i] = v[i - r];
+            all = all && v[i - r];
+        }
+        r = g;
+    }
+    return all;
+}
+
+// length block (AAD bits || CT bits), big-endian 64-bit each, then tag = GHASH ^ E(K, J0)
+void sm4_gcm_simd::finish_tag(const uint8_t j0[16], __m128i y, size_t aad_len, size_t ct_len, uint8_t tag[16]) const {
     uint8_t len_block[BLOCK_SIZE] = { 0 };
     uint64_t aad_bits = static_cast<uint64_t>(aad_len) * 8;
     uint64_t ct_bits = static_cast<uint64_t>(ct_len) * 8;
@@ -211,11 +476,22 @@ void sm4_gcm_simd::ghash(const uint8_t* aad, size_t aad_len,
         len_block[7 - i] = static_cast<uint8_t>((aad_bits >> (i * 8)) & 0xff);
         len_block[15 - i] = static_cast<uint8_t>((ct_bits >> (i * 8)) & 0xff);
     }
+    y = gh.update(y, len_block, 1);
+    ghash_clmul::store_state(y, tag);
 
-    xor_block(Y, len_block);
-    gmul(Y, H);
+    uint8_t Ek0[BLOCK_SIZE];
+    cipher.encryptBlock(j0, Ek0);
+    xor_block(tag, Ek0);
+}
+
+// constant-time comparison of the tag computed from y with tag
+bool sm4_gcm_simd::tag_equal(const uint8_t j0[16], __m128i y, size_t aad_len, size_t ct_len, const uint8_t tag[16]) const {
+    uint8_t computed_tag[BLOCK_SIZE];
+    finish_tag(j0, y, aad_len, ct_len, computed_tag);
 
-    std::memcpy(tag, Y, BLOCK_SIZE);
+    uint8_t diff = 0;
+    for (int i = 0; i < 16; ++i) diff |= (computed_tag[i] ^ tag[i]);
+    return diff == 0;
 }
 
 void sm4_gcm_simd::xor_block(uint8_t out[16], const uint8_t in[16]) {
@@ -226,34 +502,12 @@ void sm4_gcm_simd::inc32(uint8_t block[16]) {
     for (int i = 15; i >= 12; --i) if (++block[i]) break;
 }
 
-/*
-  gmul: use PCLMUL with byte-reversal so that in-register 64-bit halves line up
-  with the CLMUL expectations and produce the same numeric result as software GHASH.
-  We perform:
-    xr = byte_reverse(X)
-    yr = byte_reverse(Y)
-    r = ghash_multiply(xr, yr)   // uses CLMUL & reduction
-    rout = byte_reverse(r)
-    store rout into X
-*/
-void sm4_gcm_simd::gmul(uint8_t X[16], const uint8_t Y[16]) {
-    // reverse mask for _mm_shuffle_epi8: reverse bytes within 128-bit lane
-    const __m128i REV = _mm_setr_epi8(
-        15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0
-    );
-
-    __m128i x = load128(X);
-    __m128i y = load128(Y);
-
-    // byte-reverse to convert big-endian (memory) -> little-endian lane order for CLMUL
-    __m128i xr = _mm_shuffle_epi8(x, REV);
-    __m128i yr = _mm_shuffle_epi8(y, REV);
-
-    // CLMUL product + reduction
-    __m128i r = ghash_multiply(xr, yr);
-
-    // reverse bytes back to memory big-endian ordering
-    __m128i rout = _mm_shuffle_epi8(r, REV);
-
-    store128(X, rout);
+void sm4_gcm_simd::counter_at(const uint8_t j0[16], uint64_t k, uint8_t ctr[16]) {
+    std::memcpy(ctr, j0, 12);
+    uint32_t c = (uint32_t(j0[12]) << 24 | uint32_t(j0[13]) << 16 | uint32_t(j0[14]) << 8 | j0[15]) +
+        static_cast<uint32_t>(k + 1);
+    ctr[12] = static_cast<uint8_t>(c >> 24);
+    ctr[13] = static_cast<uint8_t>(c >> 16);
+    ctr[14] = static_cast<uint8_t>(c >> 8);
+    ctr[15] = static_cast<uint8_t>(c);
 }
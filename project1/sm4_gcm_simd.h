@@ -3,14 +3,96 @@
 #include <cstdint>
 #include <cstddef>
 #include <wmmintrin.h>  // PCLMULQDQ + SSE intrinsics
-#include "sm4.h"
+#include "sm4_aesni.h"
+#include "sm4_ghash.h"
+#include "sm4_parallel.h"
 
-// Note: compile with -msse4.1 -mpclmul (GCC/Clang)
+// Note: no -m flags needed; the code here is SSE2, the sm4_aesni and
+// ghash_clmul kernels carry their own target(...) (GCC/Clang)
+
+// Single pass over the data: every iteration encrypts 16 counter blocks with the
+// AES-NI SM4 kernel and folds 16 ciphertext blocks into GHASH (VPCLMULQDQ when
+// the CPU has it, PCLMULQDQ otherwise).
+// Construct once per key and call seal()/open() with a fresh nonce per message;
+// both are const, so one object can serve several threads.
+// open() hashes the ciphertext and checks the tag (in constant time) before it
+// runs any keystream, so forged input is rejected at GHASH speed and plaintext
+// is written only for authentic messages. open_fused() is the single pass for
+// large trusted input; it wipes the plaintext when the tag does not match.
+
+// One message of a seal_batch()/open_batch() call. tag is written by
+// seal_batch and checked by open_batch; in == out is allowed.
+struct sm4_gcm_record {
+    const uint8_t* iv;
+    size_t iv_len;
+    const uint8_t* aad;
+    size_t aad_len;
+    const uint8_t* in;
+    size_t len;
+    uint8_t* out;
+    uint8_t* tag;
+};
 
 class sm4_gcm_simd {
 public:
+    explicit sm4_gcm_simd(const uint8_t key[16]);
+    explicit sm4_gcm_simd(const sm4_expanded_key& xk);
     sm4_gcm_simd(const uint8_t key[16], const uint8_t* iv, size_t iv_len);
+    sm4_gcm_simd(const sm4_expanded_key& xk, const uint8_t* iv, size_t iv_len);
+
+    void seal(const uint8_t* iv, size_t iv_len,
+        const uint8_t* plaintext, size_t len,
+        const uint8_t* aad, size_t aad_len,
+        uint8_t* ciphertext, uint8_t tag[16]) const;
+
+    bool open(const uint8_t* iv, size_t iv_len,
+        const uint8_t* ciphertext, size_t len,
+        const uint8_t* aad, size_t aad_len,
+        const uint8_t tag[16], uint8_t* plaintext) const;
+
+    bool open_fused(const uint8_t* iv, size_t iv_len,
+        const uint8_t* ciphertext, size_t len,
+        const uint8_t* aad, size_t aad_len,
+        const uint8_t tag[16], uint8_t* plaintext) const;
 
+    // Same result as seal()/open(), with the message split into chunks of
+    // sm4_parallel_chunk_blocks blocks across the pool's threads. Each chunk
+    // runs CTR over its own counter range and hashes its ciphertext from a
+    // zero state; the partial hashes are then joined in order with H^chunk
+    // (precomputed per key), so the tag does not depend on the thread count.
+    // open_parallel() verifies first (parallel GHASH, then parallel CTR);
+    // open_parallel_fused() is the stitched pass, plaintext wiped on failure.
+    void seal_parallel(const uint8_t* iv, size_t iv_len,
+        const uint8_t* plaintext, size_t len,
+        const uint8_t* aad, size_t aad_len,
+        uint8_t* ciphertext, uint8_t tag[16],
+        sm4_thread_pool& pool = sm4_thread_pool::shared()) const;
+
+    bool open_parallel(const uint8_t* iv, size_t iv_len,
+        const uint8_t* ciphertext, size_t len,
+        const uint8_t* aad, size_t aad_len,
+        const uint8_t tag[16], uint8_t* plaintext,
+        sm4_thread_pool& pool = sm4_thread_pool::shared()) const;
+
+    bool open_parallel_fused(const uint8_t* iv, size_t iv_len,
+        const uint8_t* ciphertext, size_t len,
+        const uint8_t* aad, size_t aad_len,
+        const uint8_t tag[16], uint8_t* plaintext,
+        sm4_thread_pool& pool = sm4_thread_pool::shared()) const;
+
+    // Many short independent messages under this key (e.g. 64-1500 byte
+    // records). Records are packed into groups; the counter blocks of a whole
+    // group, E(K, J0) for every tag included, go through the SM4 kernel in one
+    // call so all lanes stay busy, and the GHASH chains of the group run
+    // side by side (ghash_clmul::update_lanes), each record aggregated as
+    // AAD || C || lengths. Records too large for a group take the seal()/open() path.
+    void seal_batch(const sm4_gcm_record* recs, size_t n) const;
+    // ok[i] (if not null) tells whether record i verified; true if all did.
+    // All tags of a group are checked before any keystream is generated; the
+    // output of a record that fails is left untouched.
+    bool open_batch(const sm4_gcm_record* recs, size_t n, bool* ok = nullptr) const;
+
+    // use the IV given to the constructor
     void encrypt(const uint8_t* plaintext, size_t len,
         const uint8_t* aad, size_t aad_len,
         uint8_t* ciphertext, uint8_t tag[16]);
@@ -20,23 +102,41 @@ public:
         const uint8_t tag[16], uint8_t* plaintext);
 
 private:
-    sm4 cipher;
-    uint8_t H[16];    // Hash subkey
-    uint8_t J0[16];   // Pre-counter block
-    uint8_t counter[16]; 
+    sm4_aesni cipher;
+    uint8_t H[16];        // Hash subkey
+    uint8_t J0[16] = {};  // Pre-counter block of the constructor IV
+    ghash_clmul gh;       // H^1..H^16, 8 or 16 blocks per GHASH iteration
+    __m128i Hchunk;       // H^sm4_parallel_chunk_blocks, byte-reflected
 
-    void ghash(const uint8_t* aad, size_t aad_len,
-        const uint8_t* ct, size_t ct_len,
-        uint8_t tag[16]);
+    void init_j0(const uint8_t* iv, size_t iv_len, uint8_t j0[16]) const;
+    void seal_j0(const uint8_t j0[16], const uint8_t* plaintext, size_t len,
+        const uint8_t* aad, size_t aad_len,
+        uint8_t* ciphertext, uint8_t tag[16]) const;
+    bool open_j0(const uint8_t j0[16], const uint8_t* ciphertext, size_t len,
+        const uint8_t* aad, size_t aad_len,
+        const uint8_t tag[16], uint8_t* plaintext) const;
+    // GHASH of len bytes, the last block zero padded; y is byte-reflected
+    __m128i ghash_update(__m128i y, const uint8_t* data, size_t len) const;
+    // seal_pass/open_pass: CTR stitched with GHASH over the ciphertext;
+    // hash_pass: GHASH of the input only; ctr_pass: keystream only
+    enum pass { seal_pass, open_pass, hash_pass, ctr_pass };
+    // CTR from the counter block ctr and/or GHASH, as selected by p
+    __m128i ctr_ghash(const uint8_t ctr[16], __m128i y, const uint8_t* in, size_t len, uint8_t* out, pass p) const;
+    __m128i ctr_ghash_parallel(const uint8_t j0[16], __m128i y, const uint8_t* in, size_t len, uint8_t* out,
+        pass p, sm4_thread_pool& pool) const;
+    void finish_tag(const uint8_t j0[16], __m128i y, size_t aad_len, size_t ct_len, uint8_t tag[16]) const;
+    bool tag_equal(const uint8_t j0[16], __m128i y, size_t aad_len, size_t ct_len, const uint8_t tag[16]) const;
+    // records [0, n) that fit one group; seals when ok is null, otherwise
+    // verifies into ok[i] and decrypts the records that passed
+    void crypt_group(const sm4_gcm_record* recs, size_t n, bool* ok) const;
 
-    void gmul(uint8_t X[16], const uint8_t Y[16]); // X = X * Y in GF(2^128)
-    void xor_block(uint8_t out[16], const uint8_t in[16]);
-    void inc32(uint8_t block[16]);
-    void encrypt_ctr(const uint8_t* input, size_t len, uint8_t* output);
+    static void xor_block(uint8_t out[16], const uint8_t in[16]);
+    static void inc32(uint8_t block[16]);
+    // counter block of data block k: inc32 applied k + 1 times to J0
+    static void counter_at(const uint8_t j0[16], uint64_t k, uint8_t ctr[16]);
 
     // SIMD helpers
     static inline __m128i load128(const uint8_t* b);
     static inline void store128(uint8_t* b, __m128i v);
-    static inline __m128i ghash_multiply(__m128i a, __m128i b);
     static inline __m128i xor128(__m128i a, __m128i b);
 };
@@ -0,0 +1,201 @@
+#include "sm4_gcm_stream.h"
+#include <cstring>
+#include <emmintrin.h>
+
+// GCM limit on the plaintext: 2^39 - 256 bits
+static const uint64_t max_ct_len = (1ULL << 36) - 32;
+
+static inline void inc32(uint8_t block[16]) {
+    for (int i = 15; i >= 12; --i) if (++block[i]) break;
+}
+
+static inline void put_be64(uint8_t* p, uint64_t v) {
+    for (int i = 0; i < 8; ++i)
+        p[i] = static_cast<uint8_t>(v >> (56 - 8 * i));
+}
+
+sm4_gcm_stream::sm4_gcm_stream(const uint8_t key[16]) {
+    cipher.setKey(key);
+    uint8_t H[16] = { 0 };
+    cipher.encryptBlock(H, H);
+    gh.init(H);
+}
+
+// Schedule and H come precomputed from sm4_key_cache
+sm4_gcm_stream::sm4_gcm_stream(const sm4_expanded_key& xk) {
+    cipher.setExpandedKey(xk);
+    gh.init(xk.H);
+}
+
+void sm4_gcm_stream::init(const uint8_t* iv, size_t iv_len, bool decrypt) {
+    if (iv_len == 12) {
+        std::memcpy(J0, iv, 12);
+        J0[12] = 0x00; J0[13] = 0x00; J0[14] = 0x00; J0[15] = 0x01;
+    }
+    else {
+        // J0 = GHASH(IV || 0-pad || [0]64 || [len(IV)]64)
+        __m128i s = _mm_setzero_si128();
+        s = gh.update(s, iv, iv_len / 16);
+        uint8_t block[16] = { 0 };
+        if (iv_len % 16) {
+            std::memcpy(block, iv + iv_len / 16 * 16, iv_len % 16);
+            s = gh.update(s, block, 1);
+        }
+        std::memset(block, 0, 8);
+        put_be64(block + 8, static_cast<uint64_t>(iv_len) * 8);
+        s = gh.update(s, block, 1);
+        ghash_clmul::store_state(s, J0);
+    }
+    std::memcpy(counter, J0, 16);
+    inc32(counter);
+
+    y = _mm_setzero_si128();
+    aad_len = 0;
+    ct_len = 0;
+    decrypting = decrypt;
+    in_data = false;
+}
+
+bool sm4_gcm_stream::update_aad(const uint8_t* aad, size_t len) {
+    if (in_data)
+        return false;
+    size_t pos = aad_len % 16;
+    aad_len += len;
+
+    if (pos) {
+        size_t n = len < 16 - pos ? len : 16 - pos;
+        std::memcpy(partial + pos, aad, n);
+        aad += n;
+        len -= n;
+        if (pos + n < 16)
+            return true;
+        y = gh.update(y, partial, 1);
+    }
+    y = gh.update(y, aad, len / 16);
+    std::memcpy(partial, aad + len / 16 * 16, len % 16);
+    return true;
+}
+
+// the last AAD block, zero padded, goes in before the first ciphertext block
+void sm4_gcm_stream::close_aad() {
+    size_t pos = aad_len % 16;
+    if (pos) {
+        std::memset(partial + pos, 0, 16 - pos);
+        y = gh.update(y, partial, 1);
+    }
+    in_data = true;
+}
+
+void sm4_gcm_stream::next_counters(uint8_t* blocks, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        std::memcpy(blocks + 16 * i, counter, 16);
+        inc32(counter);
+    }
+}
+
+// Whole blocks, ghash_clmul::wide_stride (16) per iteration, so GHASH takes
+// the VPCLMULQDQ path where there is one. As in sm4_gcm_simd::ctr_ghash, the
+// keystream of one batch and the GHASH of another are independent and the
+// core overlaps SM4 and CLMUL work: when encrypting, iteration i hashes the
+// ciphertext of batch i-1, already written; when decrypting, it hashes the
+// input of batch i before out (maybe == in) is written.
+void sm4_gcm_stream::bulk(const uint8_t* in, uint8_t* out, size_t nblocks) {
+    const size_t batch = ghash_clmul::wide_stride;
+    uint8_t ctrs[16 * batch], buf[16 * batch];
+    const uint8_t* pending = nullptr;
+    size_t pending_blocks = 0;
+    while (nblocks) {
+        size_t n = nblocks < batch ? nblocks : batch;
+        next_counters(ctrs, n);
+        cipher.encryptBlocks(ctrs, buf, n);
+        if (decrypting)
+            y = gh.update(y, in, n);
+        else if (pending)
+            y = gh.update(y, pending, pending_blocks);
+        for (size_t i = 0; i < n; ++i) {
+            __m128i x = _mm_loadu_si128((const __m128i*)(in + 16 * i));
+            __m128i k = _mm_loadu_si128((const __m128i*)(buf + 16 * i));
+            _mm_storeu_si128((__m128i*)(out + 16 * i), _mm_xor_si128(x, k));
+        }
+        pending = out;
+        pending_blocks = n;
+        in += 16 * n;
+        out += 16 * n;
+        nblocks -= n;
+    }
+    if (!decrypting && pending)
+        y = gh.update(y, pending, pending_blocks);
+}
+
+bool sm4_gcm_stream::update(const uint8_t* in, uint8_t* out, size_t len) {
+    if (len > max_ct_len || ct_len > max_ct_len - len)
+        return false;
+    if (!in_data)
+        close_aad();
+
+    size_t pos = ct_len % 16;
+    ct_len += len;
+
+    // finish the block left open by the previous call
+    if (pos) {
+        size_t n = len < 16 - pos ? len : 16 - pos;
+        for (size_t i = 0; i < n; ++i) {
+            uint8_t c = in[i];
+            out[i] = c ^ ks[pos + i];
+            partial[pos + i] = decrypting ? c : out[i];
+        }
+        in += n;
+        out += n;
+        len -= n;
+        if (pos + n < 16)
+            return true;
+        y = gh.update(y, partial, 1);
+    }
+
+    bulk(in, out, len / 16);
+    in += len / 16 * 16;
+    out += len / 16 * 16;
+    len %= 16;
+
+    // open a new block; its keystream stays for the next call
+    if (len) {
+        next_counters(ks, 1);
+        cipher.encryptBlock(ks, ks);
+        for (size_t i = 0; i < len; ++i) {
+            uint8_t c = in[i];
+            out[i] = c ^ ks[i];
+            partial[i] = decrypting ? c : out[i];
+        }
+    }
+    return true;
+}
+
+void sm4_gcm_stream::finish(uint8_t tag[16]) {
+    if (!in_data)
+        close_aad();
+    size_t pos = ct_len % 16;
+    if (pos) {
+        std::memset(partial + pos, 0, 16 - pos);
+        y = gh.update(y, partial, 1);
+    }
+
+    uint8_t len_block[16];
+    put_be64(len_block, aad_len * 8);
+    put_be64(len_block + 8, ct_len * 8);
+    y = gh.update(y, len_block, 1);
+    ghash_clmul::store_state(y, tag);
+
+    uint8_t Ek0[16];
+    cipher.encryptBlock(J0, Ek0);
+    for (int i = 0; i < 16; ++i)
+        tag[i] ^= Ek0[i];
+}
+
+bool sm4_gcm_stream::finish_verify(const uint8_t tag[16]) {
+    uint8_t computed[16];
+    finish(computed);
+    uint8_t diff = 0;
+    for (int i = 0; i < 16; ++i)
+        diff |= computed[i] ^ tag[i];
+    return diff == 0;
+}
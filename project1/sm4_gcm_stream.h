@@ -0,0 +1,64 @@
+#pragma once
+#ifndef SM4_GCM_STREAM_H
+#define SM4_GCM_STREAM_H
+
+#include <cstdint>
+#include <cstddef>
+#include <wmmintrin.h>
+#include "sm4_aesni.h"
+#include "sm4_ghash.h"
+
+// Note: no -m flags needed; the code here is SSE2, the sm4_aesni and
+// ghash_clmul kernels carry their own target(...) (GCC/Clang)
+
+// Incremental SM4-GCM for data that does not fit in memory at once.
+//
+//   sm4_gcm_stream g(key);
+//   g.init(iv, 12);                    // or init(iv, 12, true) to decrypt
+//   g.update_aad(hdr, hdr_len);        // any number of calls, before update()
+//   g.update(in, out, n);              // any chunk sizes, in == out allowed
+//   g.finish(tag);                     // or g.finish_verify(tag) when decrypting
+//
+// A partly used keystream block and a partly filled GHASH block carry over
+// between calls, so the result does not depend on how the input is split.
+// Whole blocks go through a single-pass CTR + GHASH loop of 16 blocks per
+// iteration, stitched like sm4_gcm_simd's, so GHASH uses the VPCLMULQDQ path
+// where available. init() may be called again to start the next message
+// under the same key.
+class sm4_gcm_stream {
+public:
+    explicit sm4_gcm_stream(const uint8_t key[16]);
+    explicit sm4_gcm_stream(const sm4_expanded_key& xk);
+
+    void init(const uint8_t* iv, size_t iv_len, bool decrypt = false);
+
+    // false once update() has been called for this message
+    bool update_aad(const uint8_t* aad, size_t len);
+
+    // false when the message would exceed the GCM limit of 2^36 - 32 bytes
+    bool update(const uint8_t* in, uint8_t* out, size_t len);
+
+    void finish(uint8_t tag[16]);
+    // constant-time comparison with the expected tag
+    bool finish_verify(const uint8_t tag[16]);
+
+private:
+    sm4_aesni cipher;
+    ghash_clmul gh;
+    uint8_t J0[16] = {};
+    uint8_t counter[16] = {};
+
+    __m128i y = __m128i();  // GHASH accumulator, byte-reflected
+    uint8_t partial[16];    // unfinished GHASH block (AAD or ciphertext)
+    uint8_t ks[16];         // keystream of the unfinished ciphertext block
+    uint64_t aad_len = 0;
+    uint64_t ct_len = 0;
+    bool decrypting = false;
+    bool in_data = false;   // update() seen; AAD closed
+
+    void close_aad();
+    void next_counters(uint8_t* blocks, size_t n);
+    void bulk(const uint8_t* in, uint8_t* out, size_t nblocks);
+};
+
+#endif
@@ -0,0 +1,281 @@
+#include "sm4_gfni.h"
+#include "sm4_engine.h"
+#include <cstring>
+
+sm4_gfni::sm4_gfni()
+    : width(sm4_cpu().avx512f && sm4_cpu().avx512bw ? 512 : sm4_cpu().avx2 ? 256 : 128) {
+}
+
+void sm4_gfni::encryptBlocks4(const uint8_t* plaintext, uint8_t* ciphertext) const {
+    SM4_GFNI_do4(plaintext, ciphertext, rk, 0);
+}
+
+void sm4_gfni::decryptBlocks4(const uint8_t* ciphertext, uint8_t* plaintext) const {
+    SM4_GFNI_do4(ciphertext, plaintext, rk, 1);
+}
+
+void sm4_gfni::encryptBlocks16(const uint8_t* plaintext, uint8_t* ciphertext) const {
+    SM4_GFNI_do16(plaintext, ciphertext, rk, 0);
+}
+
+void sm4_gfni::decryptBlocks16(const uint8_t* ciphertext, uint8_t* plaintext) const {
+    SM4_GFNI_do16(ciphertext, plaintext, rk, 1);
+}
+
+void sm4_gfni::encryptBlocks32(const uint8_t* plaintext, uint8_t* ciphertext) const {
+    SM4_GFNI_do32(plaintext, ciphertext, rk, 0);
+}
+
+void sm4_gfni::decryptBlocks32(const uint8_t* ciphertext, uint8_t* plaintext) const {
+    SM4_GFNI_do32(ciphertext, plaintext, rk, 1);
+}
+
+// Kernels of the width set by setWidth(). The last partial group goes through
+// a masked single-group kernel (256/512) or a zero-padded 4-block buffer (128).
+void sm4_gfni::cryptBlocks(const uint8_t* in, uint8_t* out, size_t nblocks, int enc) const {
+    size_t i = 0;
+    if (width == 512) {
+        for (; nblocks - i >= 32; i += 32)
+            SM4_GFNI_do32(in + 16 * i, out + 16 * i, rk, enc);
+        for (; i < nblocks; i += 16)
+            SM4_GFNI_tail16(in + 16 * i, out + 16 * i, rk, enc, nblocks - i < 16 ? nblocks - i : 16);
+    }
+    else if (width == 256) {
+        for (; nblocks - i >= 16; i += 16)
+            SM4_GFNI_do16(in + 16 * i, out + 16 * i, rk, enc);
+        for (; i < nblocks; i += 8)
+            SM4_GFNI_tail8(in + 16 * i, out + 16 * i, rk, enc, nblocks - i < 8 ? nblocks - i : 8);
+    }
+    else {
+        for (; nblocks - i >= 4; i += 4)
+            SM4_GFNI_do4(in + 16 * i, out + 16 * i, rk, enc);
+        if (i < nblocks) {
+            uint8_t buf[64] = { 0 };
+            std::memcpy(buf, in + 16 * i, 16 * (nblocks - i));
+            SM4_GFNI_do4(buf, buf, rk, enc);
+            std::memcpy(out + 16 * i, buf, 16 * (nblocks - i));
+        }
+    }
+}
+
+void sm4_gfni::encryptBlocks(const uint8_t* in, uint8_t* out, size_t nblocks) const {
+    cryptBlocks(in, out, nblocks, 0);
+}
+
+void sm4_gfni::decryptBlocks(const uint8_t* in, uint8_t* out, size_t nblocks) const {
+    cryptBlocks(in, out, nblocks, 1);
+}
+
+// Word transposes. unpack works inside each 128-bit lane, so in the wide
+// registers lane l carries blocks l, l+W/4, ...; the store undoes the same mapping.
+#define GFNI_TRANSPOSE(W, S, a, b, c, d, X) do {                                           \
+        __m##W##i t0 = _mm##S##_unpacklo_epi32(a, b), t1 = _mm##S##_unpacklo_epi32(c, d); \
+        __m##W##i t2 = _mm##S##_unpackhi_epi32(a, b), t3 = _mm##S##_unpackhi_epi32(c, d); \
+        X[0] = _mm##S##_unpacklo_epi64(t0, t1);                                           \
+        X[1] = _mm##S##_unpackhi_epi64(t0, t1);                                           \
+        X[2] = _mm##S##_unpacklo_epi64(t2, t3);                                           \
+        X[3] = _mm##S##_unpackhi_epi64(t2, t3);                                           \
+    } while (0)
+
+static inline SM4_TARGET("gfni,ssse3") void load4(const uint8_t* in, __m128i X[4]) {
+    const __m128i vindex = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    GFNI_TRANSPOSE(128, ,
+        _mm_loadu_si128((const __m128i*)in + 0), _mm_loadu_si128((const __m128i*)in + 1),
+        _mm_loadu_si128((const __m128i*)in + 2), _mm_loadu_si128((const __m128i*)in + 3), X);
+    for (int j = 0; j < 4; ++j)
+        X[j] = _mm_shuffle_epi8(X[j], vindex);
+}
+
+static inline SM4_TARGET("gfni,ssse3") void store4(uint8_t* out, __m128i X[4]) {
+    const __m128i vindex = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    __m128i Y[4];
+    for (int j = 0; j < 4; ++j)
+        X[j] = _mm_shuffle_epi8(X[j], vindex);
+    GFNI_TRANSPOSE(128, , X[3], X[2], X[1], X[0], Y);
+    for (int j = 0; j < 4; ++j)
+        _mm_storeu_si128((__m128i*)out + j, Y[j]);
+}
+
+// Tail masks for a partial group of n blocks: register j covers blocks
+// W/128*j onwards, lanes past the n-th block are neither read nor written.
+static inline SM4_TARGET("gfni,avx2") __m256i tail_mask8(size_t n, int j) {
+    return _mm256_cmpgt_epi32(_mm256_set1_epi32((int)(4 * n) - 8 * j),
+        _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+}
+
+static inline __mmask16 tail_mask16(size_t n, int j) {
+    int d = (int)(4 * n) - 16 * j;
+    return d <= 0 ? 0 : d >= 16 ? 0xffff : (__mmask16)((1u << d) - 1);
+}
+
+static inline SM4_TARGET("gfni,avx2") void load8(const uint8_t* in, __m256i X[4], size_t n = 8) {
+    const __m256i vindex = _mm256_broadcastsi128_si256(
+        _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12));
+    __m256i T[4];
+    for (int j = 0; j < 4; ++j)
+        T[j] = n == 8 ? _mm256_loadu_si256((const __m256i*)in + j)
+                      : _mm256_maskload_epi32((const int*)in + 8 * j, tail_mask8(n, j));
+    GFNI_TRANSPOSE(256, 256, T[0], T[1], T[2], T[3], X);
+    for (int j = 0; j < 4; ++j)
+        X[j] = _mm256_shuffle_epi8(X[j], vindex);
+}
+
+static inline SM4_TARGET("gfni,avx2") void store8(uint8_t* out, __m256i X[4], size_t n = 8) {
+    const __m256i vindex = _mm256_broadcastsi128_si256(
+        _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12));
+    __m256i Y[4];
+    for (int j = 0; j < 4; ++j)
+        X[j] = _mm256_shuffle_epi8(X[j], vindex);
+    GFNI_TRANSPOSE(256, 256, X[3], X[2], X[1], X[0], Y);
+    for (int j = 0; j < 4; ++j) {
+        if (n == 8)
+            _mm256_storeu_si256((__m256i*)out + j, Y[j]);
+        else
+            _mm256_maskstore_epi32((int*)out + 8 * j, tail_mask8(n, j), Y[j]);
+    }
+}
+
+static inline SM4_TARGET("gfni,avx512f,avx512bw") void load16(const uint8_t* in, __m512i X[4], size_t n = 16) {
+    const __m512i vindex = _mm512_broadcast_i32x4(
+        _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12));
+    __m512i T[4];
+    for (int j = 0; j < 4; ++j)
+        T[j] = _mm512_maskz_loadu_epi32(tail_mask16(n, j), in + 64 * j);
+    GFNI_TRANSPOSE(512, 512, T[0], T[1], T[2], T[3], X);
+    for (int j = 0; j < 4; ++j)
+        X[j] = _mm512_shuffle_epi8(X[j], vindex);
+}
+
+static inline SM4_TARGET("gfni,avx512f,avx512bw") void store16(uint8_t* out, __m512i X[4], size_t n = 16) {
+    const __m512i vindex = _mm512_broadcast_i32x4(
+        _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12));
+    __m512i Y[4];
+    for (int j = 0; j < 4; ++j)
+        X[j] = _mm512_shuffle_epi8(X[j], vindex);
+    GFNI_TRANSPOSE(512, 512, X[3], X[2], X[1], X[0], Y);
+    for (int j = 0; j < 4; ++j)
+        _mm512_mask_storeu_epi32(out + 64 * j, tail_mask16(n, j), Y[j]);
+}
+
+SM4_TARGET("gfni,ssse3") void sm4_gfni::SM4_GFNI_do4(const uint8_t* in, uint8_t* out, const uint32_t* rk, int enc) {
+    __m128i X[4], Tmp;
+    load4(in, X);
+
+    for (int i = 0; i < 32; i++) {
+        __m128i k = _mm_set1_epi32(enc == 0 ? rk[i] : rk[31 - i]);
+        Tmp = _mm_xor_si128(_mm_xor_si128(X[1], X[2]), _mm_xor_si128(X[3], k));
+        Tmp = _mm_xor_si128(X[0], SM4_T(Tmp));
+        X[0] = X[1]; X[1] = X[2]; X[2] = X[3]; X[3] = Tmp;
+    }
+
+    store4(out, X);
+}
+
+SM4_TARGET("gfni,avx2") void sm4_gfni::SM4_GFNI_do16(const uint8_t* in, uint8_t* out, const uint32_t* rk, int enc) {
+    __m256i X[4], Y[4], TmpX, TmpY;
+    load8(in, X);
+    load8(in + 128, Y);
+
+    for (int i = 0; i < 32; i++) {
+        __m256i k = _mm256_set1_epi32(enc == 0 ? rk[i] : rk[31 - i]);
+        TmpX = _mm256_xor_si256(_mm256_xor_si256(X[1], X[2]), _mm256_xor_si256(X[3], k));
+        TmpY = _mm256_xor_si256(_mm256_xor_si256(Y[1], Y[2]), _mm256_xor_si256(Y[3], k));
+        TmpX = _mm256_xor_si256(X[0], SM4_T(TmpX));
+        TmpY = _mm256_xor_si256(Y[0], SM4_T(TmpY));
+        X[0] = X[1]; X[1] = X[2]; X[2] = X[3]; X[3] = TmpX;
+        Y[0] = Y[1]; Y[1] = Y[2]; Y[2] = Y[3]; Y[3] = TmpY;
+    }
+
+    store8(out, X);
+    store8(out + 128, Y);
+}
+
+SM4_TARGET("gfni,avx512f,avx512bw") void sm4_gfni::SM4_GFNI_do32(const uint8_t* in, uint8_t* out, const uint32_t* rk, int enc) {
+    __m512i X[4], Y[4], TmpX, TmpY;
+    load16(in, X);
+    load16(in + 256, Y);
+
+    for (int i = 0; i < 32; i++) {
+        __m512i k = _mm512_set1_epi32(enc == 0 ? rk[i] : rk[31 - i]);
+        // 0x96: three-way xor
+        TmpX = _mm512_ternarylogic_epi32(X[1], X[2], _mm512_xor_si512(X[3], k), 0x96);
+        TmpY = _mm512_ternarylogic_epi32(Y[1], Y[2], _mm512_xor_si512(Y[3], k), 0x96);
+        TmpX = _mm512_xor_si512(X[0], SM4_T(TmpX));
+        TmpY = _mm512_xor_si512(Y[0], SM4_T(TmpY));
+        X[0] = X[1]; X[1] = X[2]; X[2] = X[3]; X[3] = TmpX;
+        Y[0] = Y[1]; Y[1] = Y[2]; Y[2] = Y[3]; Y[3] = TmpY;
+    }
+
+    store16(out, X);
+    store16(out + 256, Y);
+}
+
+// One group of n (1..8) blocks, 256-bit
+SM4_TARGET("gfni,avx2") void sm4_gfni::SM4_GFNI_tail8(const uint8_t* in, uint8_t* out, const uint32_t* rk, int enc, size_t n) {
+    __m256i X[4], Tmp;
+    load8(in, X, n);
+
+    for (int i = 0; i < 32; i++) {
+        __m256i k = _mm256_set1_epi32(enc == 0 ? rk[i] : rk[31 - i]);
+        Tmp = _mm256_xor_si256(_mm256_xor_si256(X[1], X[2]), _mm256_xor_si256(X[3], k));
+        Tmp = _mm256_xor_si256(X[0], SM4_T(Tmp));
+        X[0] = X[1]; X[1] = X[2]; X[2] = X[3]; X[3] = Tmp;
+    }
+
+    store8(out, X, n);
+}
+
+// One group of n (1..16) blocks, 512-bit
+SM4_TARGET("gfni,avx512f,avx512bw") void sm4_gfni::SM4_GFNI_tail16(const uint8_t* in, uint8_t* out, const uint32_t* rk, int enc, size_t n) {
+    __m512i X[4], Tmp;
+    load16(in, X, n);
+
+    for (int i = 0; i < 32; i++) {
+        __m512i k = _mm512_set1_epi32(enc == 0 ? rk[i] : rk[31 - i]);
+        Tmp = _mm512_ternarylogic_epi32(X[1], X[2], _mm512_xor_si512(X[3], k), 0x96);
+        Tmp = _mm512_xor_si512(X[0], SM4_T(Tmp));
+        X[0] = X[1]; X[1] = X[2]; X[2] = X[3]; X[3] = Tmp;
+    }
+
+    store16(out, X, n);
+}
+
+// T = L(tau(x)); tau is two GFNI instructions, L uses byte shuffles for the
+// 8/16/24-bit rotations: L(x) = x ^ (x <<< 24) ^ ((x ^ (x <<< 8) ^ (x <<< 16)) <<< 2)
+SM4_TARGET("gfni,ssse3") __m128i sm4_gfni::SM4_T(__m128i x) {
+    const __m128i r8 = _mm_setr_epi8(3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14);
+    const __m128i r16 = _mm_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13);
+    const __m128i r24 = _mm_setr_epi8(1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12);
+
+    x = _mm_gf2p8affine_epi64_epi8(x, _mm_set1_epi64x(M1), C1);
+    x = _mm_gf2p8affineinv_epi64_epi8(x, _mm_set1_epi64x(M2), C2);
+
+    __m128i t = _mm_xor_si128(_mm_xor_si128(x, _mm_shuffle_epi8(x, r8)), _mm_shuffle_epi8(x, r16));
+    t = _mm_xor_si128(_mm_slli_epi32(t, 2), _mm_srli_epi32(t, 30));
+    return _mm_xor_si128(_mm_xor_si128(x, _mm_shuffle_epi8(x, r24)), t);
+}
+
+SM4_TARGET("gfni,avx2") __m256i sm4_gfni::SM4_T(__m256i x) {
+    const __m256i r8 = _mm256_broadcastsi128_si256(
+        _mm_setr_epi8(3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14));
+    const __m256i r16 = _mm256_broadcastsi128_si256(
+        _mm_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13));
+    const __m256i r24 = _mm256_broadcastsi128_si256(
+        _mm_setr_epi8(1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12));
+
+    x = _mm256_gf2p8affine_epi64_epi8(x, _mm256_set1_epi64x(M1), C1);
+    x = _mm256_gf2p8affineinv_epi64_epi8(x, _mm256_set1_epi64x(M2), C2);
+
+    __m256i t = _mm256_xor_si256(_mm256_xor_si256(x, _mm256_shuffle_epi8(x, r8)), _mm256_shuffle_epi8(x, r16));
+    t = _mm256_xor_si256(_mm256_slli_epi32(t, 2), _mm256_srli_epi32(t, 30));
+    return _mm256_xor_si256(_mm256_xor_si256(x, _mm256_shuffle_epi8(x, r24)), t);
+}
+
+// AVX-512 has a real VPROLD, so L is four rotates folded by two ternary xors
+SM4_TARGET("gfni,avx512f,avx512bw") __m512i sm4_gfni::SM4_T(__m512i x) {
+    x = _mm512_gf2p8affine_epi64_epi8(x, _mm512_set1_epi64(M1), C1);
+    x = _mm512_gf2p8affineinv_epi64_epi8(x, _mm512_set1_epi64(M2), C2);
+
+    __m512i t = _mm512_ternarylogic_epi32(x, _mm512_rol_epi32(x, 2), _mm512_rol_epi32(x, 10), 0x96);
+    return _mm512_ternarylogic_epi32(t, _mm512_rol_epi32(x, 18), _mm512_rol_epi32(x, 24), 0x96);
+}
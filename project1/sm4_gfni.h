@@ -0,0 +1,63 @@
+#pragma once
+#ifndef SM4_GFNI_H
+#define SM4_GFNI_H
+
+#include "sm4.h"
+#include <immintrin.h>
+
+// Note: no -m flags needed; the 128-, 256- and 512-bit kernels carry
+// target("gfni,ssse3"), ("gfni,avx2") and ("gfni,avx512f,avx512bw") (GCC/Clang)
+
+// SM4 with the S-box computed by GFNI:
+//   S(x) = M2 * inv(M1 * x + c1) + c2
+// M1/c1 move x into the AES field (gf2p8affineqb), gf2p8affineinvqb inverts
+// there and applies M2/c2 to come back and finish the SM4 affine map.
+class sm4_gfni : public sm4 {
+public:
+    // bulk path: 512-bit with AVX-512F/BW, else 256-bit with AVX2, else 128-bit
+    sm4_gfni();
+
+    // force the 512-, 256- or 128-bit path of encryptBlocks/decryptBlocks;
+    // 512 requires AVX-512F/BW, 256 AVX2
+    void setWidth(unsigned bits) { width = bits; }
+
+    // 128-bit: 4 blocks (64 bytes) per call
+    void encryptBlocks4(const uint8_t* plaintext, uint8_t* ciphertext) const;
+    void decryptBlocks4(const uint8_t* ciphertext, uint8_t* plaintext) const;
+
+    // 256-bit: 16 blocks (256 bytes) per call, two 8-block groups
+    void encryptBlocks16(const uint8_t* plaintext, uint8_t* ciphertext) const;
+    void decryptBlocks16(const uint8_t* ciphertext, uint8_t* plaintext) const;
+
+    // 512-bit: 32 blocks (512 bytes) per call, two 16-block groups
+    void encryptBlocks32(const uint8_t* plaintext, uint8_t* ciphertext) const;
+    void decryptBlocks32(const uint8_t* ciphertext, uint8_t* plaintext) const;
+
+    // any number of blocks, see setWidth()
+    void encryptBlocks(const uint8_t* in, uint8_t* out, size_t nblocks) const;
+    void decryptBlocks(const uint8_t* in, uint8_t* out, size_t nblocks) const;
+
+private:
+    void cryptBlocks(const uint8_t* in, uint8_t* out, size_t nblocks, int enc) const;
+
+    static void SM4_GFNI_do4(const uint8_t* in, uint8_t* out, const uint32_t* rk, int enc);
+    static void SM4_GFNI_do16(const uint8_t* in, uint8_t* out, const uint32_t* rk, int enc);
+    static void SM4_GFNI_do32(const uint8_t* in, uint8_t* out, const uint32_t* rk, int enc);
+    // single masked group of n blocks
+    static void SM4_GFNI_tail8(const uint8_t* in, uint8_t* out, const uint32_t* rk, int enc, size_t n);
+    static void SM4_GFNI_tail16(const uint8_t* in, uint8_t* out, const uint32_t* rk, int enc, size_t n);
+
+    static __m128i SM4_T(__m128i x);
+    static __m256i SM4_T(__m256i x);
+    static __m512i SM4_T(__m512i x);
+
+    // GFNI affine matrices (row for output bit i in byte 7-i)
+    static const long long M1 = 0x06170a353a729b0dLL;
+    static const long long M2 = (long long)0xaf4db0439a96b349ULL;
+    static const int C1 = 0x23;
+    static const int C2 = 0xd3;
+
+    unsigned width;
+};
+
+#endif
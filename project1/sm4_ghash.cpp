@@ -0,0 +1,190 @@
+#include "sm4_ghash.h"
+#include "sm4_engine.h"
+#include <immintrin.h>
+
+static inline SM4_TARGET("pclmul,ssse3") __m128i bswap128(__m128i x) {
+    const __m128i REV = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    return _mm_shuffle_epi8(x, REV);
+}
+
+// Reduce the 256-bit product hi:lo of two byte-reflected operands modulo
+// x^128 + x^7 + x^2 + x + 1 (Intel CLMUL white paper, algorithm 5): shift
+// left by one to undo the bit reflection, then fold the low half twice.
+static inline __m128i reduce(__m128i lo, __m128i hi) {
+    __m128i t7 = _mm_srli_epi32(lo, 31);
+    __m128i t8 = _mm_srli_epi32(hi, 31);
+    lo = _mm_slli_epi32(lo, 1);
+    hi = _mm_slli_epi32(hi, 1);
+    __m128i t9 = _mm_srli_si128(t7, 12);
+    t8 = _mm_slli_si128(t8, 4);
+    t7 = _mm_slli_si128(t7, 4);
+    lo = _mm_or_si128(lo, t7);
+    hi = _mm_or_si128(hi, t8);
+    hi = _mm_or_si128(hi, t9);
+
+    t7 = _mm_slli_epi32(lo, 31);
+    t8 = _mm_slli_epi32(lo, 30);
+    t9 = _mm_slli_epi32(lo, 25);
+    t7 = _mm_xor_si128(t7, _mm_xor_si128(t8, t9));
+    t8 = _mm_srli_si128(t7, 4);
+    t7 = _mm_slli_si128(t7, 12);
+    lo = _mm_xor_si128(lo, t7);
+
+    __m128i t2 = _mm_srli_epi32(lo, 1);
+    t2 = _mm_xor_si128(t2, _mm_srli_epi32(lo, 2));
+    t2 = _mm_xor_si128(t2, _mm_srli_epi32(lo, 7));
+    t2 = _mm_xor_si128(t2, t8);
+    lo = _mm_xor_si128(lo, t2);
+    return _mm_xor_si128(hi, lo);
+}
+
+// hi ^ lo of x in the low 64 bits
+static inline __m128i karatsuba_fold(__m128i x) {
+    return _mm_xor_si128(x, _mm_shuffle_epi32(x, 0x4e));
+}
+
+static inline SM4_TARGET("pclmul,ssse3") __m128i gf_mul(__m128i a, __m128i b) {
+    __m128i lo = _mm_clmulepi64_si128(a, b, 0x00);
+    __m128i hi = _mm_clmulepi64_si128(a, b, 0x11);
+    __m128i mid = _mm_clmulepi64_si128(karatsuba_fold(a), karatsuba_fold(b), 0x00);
+    mid = _mm_xor_si128(mid, _mm_xor_si128(lo, hi));
+    return reduce(_mm_xor_si128(lo, _mm_slli_si128(mid, 8)), _mm_xor_si128(hi, _mm_srli_si128(mid, 8)));
+}
+
+ghash_clmul::ghash_clmul()
+    : wide(sm4_cpu().vpclmulqdq && sm4_cpu().avx512f && sm4_cpu().avx512bw) {
+}
+
+SM4_TARGET("pclmul,ssse3") void ghash_clmul::init(const uint8_t H[16]) {
+    __m128i h = bswap128(_mm_loadu_si128((const __m128i*)H));
+    Hp[0] = h;
+    for (size_t i = 1; i < stride; ++i)
+        Hp[i] = gf_mul(Hp[i - 1], h);
+    for (size_t i = 0; i < stride; ++i)
+        Hk[i] = karatsuba_fold(Hp[i]);
+
+    // wide path: H^16..H^1 in lane order, H^9..H^16 by further multiplication
+    __m128i q = Hp[stride - 1];
+    for (size_t e = 1; e <= wide_stride; ++e) {
+        if (e > stride)
+            q = gf_mul(q, h);
+        Hw[wide_stride - e] = e <= stride ? Hp[e - 1] : q;
+    }
+    for (size_t i = 0; i < wide_stride; ++i)
+        Hwk[i] = karatsuba_fold(Hw[i]);
+}
+
+// xor of the four 128-bit lanes
+static inline SM4_TARGET("vpclmulqdq,avx512f,avx512bw") __m128i xor_lanes(__m512i v) {
+    __m256i t = _mm256_xor_si256(_mm512_castsi512_si256(v), _mm512_extracti64x4_epi64(v, 1));
+    return _mm_xor_si128(_mm256_castsi256_si128(t), _mm256_extracti128_si256(t, 1));
+}
+
+SM4_TARGET("vpclmulqdq,avx512f,avx512bw") __m128i ghash_clmul::update_wide(__m128i y, const uint8_t* data, size_t nblocks) const {
+    const __m512i REV = _mm512_broadcast_i32x4(_mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0));
+    __m512i H[4], K[4];
+    for (int k = 0; k < 4; ++k) {
+        H[k] = _mm512_loadu_si512((const void*)(Hw + 4 * k));
+        K[k] = _mm512_loadu_si512((const void*)(Hwk + 4 * k));
+    }
+    for (; nblocks >= wide_stride; nblocks -= wide_stride, data += 16 * wide_stride) {
+        __m512i lo = _mm512_setzero_si512(), hi = _mm512_setzero_si512(), mid = _mm512_setzero_si512();
+        for (int k = 0; k < 4; ++k) {
+            __m512i x = _mm512_shuffle_epi8(_mm512_loadu_si512((const void*)(data + 64 * k)), REV);
+            if (k == 0)
+                x = _mm512_xor_si512(x, _mm512_inserti32x4(_mm512_setzero_si512(), y, 0));
+            __m512i xk = _mm512_xor_si512(x, _mm512_shuffle_epi32(x, _MM_PERM_BADC));
+            lo = _mm512_xor_si512(lo, _mm512_clmulepi64_epi128(x, H[k], 0x00));
+            hi = _mm512_xor_si512(hi, _mm512_clmulepi64_epi128(x, H[k], 0x11));
+            mid = _mm512_xor_si512(mid, _mm512_clmulepi64_epi128(xk, K[k], 0x00));
+        }
+        __m128i l = xor_lanes(lo), h = xor_lanes(hi), m = xor_lanes(mid);
+        m = _mm_xor_si128(m, _mm_xor_si128(l, h));
+        y = reduce(_mm_xor_si128(l, _mm_slli_si128(m, 8)), _mm_xor_si128(h, _mm_srli_si128(m, 8)));
+    }
+    return y;
+}
+
+SM4_TARGET("pclmul,ssse3") __m128i ghash_clmul::load_state(const uint8_t Y[16]) {
+    return bswap128(_mm_loadu_si128((const __m128i*)Y));
+}
+
+SM4_TARGET("pclmul,ssse3") void ghash_clmul::store_state(__m128i y, uint8_t Y[16]) {
+    _mm_storeu_si128((__m128i*)Y, bswap128(y));
+}
+
+SM4_TARGET("pclmul,ssse3") __m128i ghash_clmul::mul(__m128i a, __m128i b) {
+    return gf_mul(a, b);
+}
+
+// square and multiply, starting from the precomputed powers for small n
+SM4_TARGET("pclmul,ssse3") __m128i ghash_clmul::power(uint64_t n) const {
+    if (n <= stride)
+        return Hp[n - 1];
+    __m128i r = Hp[0], x = Hp[0];
+    bool first = true;
+    for (; n; n >>= 1) {
+        if (n & 1) {
+            r = first ? x : gf_mul(r, x);
+            first = false;
+        }
+        x = gf_mul(x, x);
+    }
+    return r;
+}
+
+SM4_TARGET("pclmul,ssse3") __m128i ghash_clmul::mul_sum(const __m128i* X, size_t n) const {
+    __m128i lo = _mm_setzero_si128(), hi = _mm_setzero_si128(), mid = _mm_setzero_si128();
+    for (size_t i = 0; i < n; ++i) {
+        const __m128i h = Hp[n - 1 - i], hk = Hk[n - 1 - i];
+        lo = _mm_xor_si128(lo, _mm_clmulepi64_si128(X[i], h, 0x00));
+        hi = _mm_xor_si128(hi, _mm_clmulepi64_si128(X[i], h, 0x11));
+        mid = _mm_xor_si128(mid, _mm_clmulepi64_si128(karatsuba_fold(X[i]), hk, 0x00));
+    }
+    mid = _mm_xor_si128(mid, _mm_xor_si128(lo, hi));
+    return reduce(_mm_xor_si128(lo, _mm_slli_si128(mid, 8)), _mm_xor_si128(hi, _mm_srli_si128(mid, 8)));
+}
+
+SM4_TARGET("pclmul,ssse3") __m128i ghash_clmul::update(__m128i y, const uint8_t* data, size_t nblocks) const {
+    if (wide && nblocks >= wide_stride) {
+        y = update_wide(y, data, nblocks);
+        data += 16 * (nblocks - nblocks % wide_stride);
+        nblocks %= wide_stride;
+    }
+    __m128i X[stride];
+    while (nblocks) {
+        size_t n = nblocks < stride ? nblocks : stride;
+        for (size_t i = 0; i < n; ++i)
+            X[i] = bswap128(_mm_loadu_si128((const __m128i*)data + i));
+        X[0] = _mm_xor_si128(X[0], y);
+        y = mul_sum(X, n);
+        data += 16 * n;
+        nblocks -= n;
+    }
+    return y;
+}
+
+SM4_TARGET("pclmul,ssse3") void ghash_clmul::update_lanes(__m128i y[], const uint8_t* const data[], const size_t nblocks[], size_t lanes) const {
+    size_t done[stride] = {};
+    __m128i X[stride];
+    for (bool more = true; more;) {
+        more = false;
+        for (size_t l = 0; l < lanes; ++l) {
+            size_t left = nblocks[l] - done[l];
+            if (!left)
+                continue;
+            size_t n = left < stride ? left : stride;
+            const uint8_t* p = data[l] + 16 * done[l];
+            for (size_t i = 0; i < n; ++i)
+                X[i] = bswap128(_mm_loadu_si128((const __m128i*)p + i));
+            X[0] = _mm_xor_si128(X[0], y[l]);
+            y[l] = mul_sum(X, n);
+            done[l] += n;
+            more = more || done[l] < nblocks[l];
+        }
+    }
+}
+
+SM4_TARGET("pclmul,ssse3") void ghash_clmul::update(uint8_t Y[16], const uint8_t* data, size_t nblocks) const {
+    store_state(update(load_state(Y), data, nblocks), Y);
+}
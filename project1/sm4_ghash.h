@@ -0,0 +1,76 @@
+#pragma once
+#ifndef SM4_GHASH_H
+#define SM4_GHASH_H
+
+#include <cstdint>
+#include <cstddef>
+#include <wmmintrin.h>
+
+// Note: no -m flags needed; the 8-block path carries target("pclmul,ssse3"),
+// the 16-block update_wide() target("vpclmulqdq,avx512f,avx512bw") (GCC/Clang)
+
+// GHASH (GCM's universal hash) with PCLMULQDQ.
+//
+// init() precomputes H^1..H^8 in byte-reflected form. update() folds eight
+// blocks per iteration, X1*H^8 ^ X2*H^7 ^ ... ^ X8*H, with Karatsuba
+// multiplies whose 256-bit products are summed first and reduced once. The
+// accumulator stays in a register for the whole call.
+//
+// On CPUs with VPCLMULQDQ and AVX-512 update() takes 16 blocks per iteration
+// instead: four 512-bit registers of four blocks each are multiplied by
+// H^16..H^1 lane-wise (one instruction per partial product for four blocks),
+// the lanes are summed and the result is reduced once.
+class ghash_clmul {
+public:
+    // blocks folded per iteration
+    static const size_t stride = 8;
+    static const size_t wide_stride = 16;
+
+    // 16-block VPCLMULQDQ path on when the CPU supports it
+    ghash_clmul();
+
+    // force the VPCLMULQDQ (true) or PCLMULQDQ (false) path;
+    // true requires VPCLMULQDQ and AVX-512F/BW
+    void setWide(bool on) { wide = on; }
+    bool isWide() const { return wide; }
+
+    void init(const uint8_t H[16]);
+
+    // Y = (...((Y ^ X1) * H ^ X2) * H ...) * H over nblocks full 16-byte blocks.
+    // Y is in GCM byte order.
+    void update(uint8_t Y[16], const uint8_t* data, size_t nblocks) const;
+
+    // Same on a byte-reflected accumulator kept in a register, for callers that
+    // interleave GHASH with other work (see load_state/store_state)
+    __m128i update(__m128i y, const uint8_t* data, size_t nblocks) const;
+
+    // lanes (<= stride) independent accumulators in lock-step: y[i] absorbs
+    // nblocks[i] blocks of data[i]. One stride of each chain per round, so
+    // the multiplies of one chain fill the reduction latency of another.
+    void update_lanes(__m128i y[], const uint8_t* const data[], const size_t nblocks[], size_t lanes) const;
+
+    static __m128i load_state(const uint8_t Y[16]);
+    static void store_state(__m128i y, uint8_t Y[16]);
+
+    // a * b in GF(2^128), both byte-reflected
+    static __m128i mul(__m128i a, __m128i b);
+    // H^n (n >= 1), byte-reflected; for joining GHASH states of separate chunks:
+    // GHASH(A || B) = GHASH(A) * H^blocks(B) ^ GHASH(B)
+    __m128i power(uint64_t n) const;
+
+private:
+    // Hp[i] = H^(i+1) reflected; Hk[i] has H^(i+1)'s hi ^ lo in its low half (Karatsuba)
+    __m128i Hp[stride];
+    __m128i Hk[stride];
+    // wide path, in register lane order: Hw[i] = H^(16-i), Hwk[i] its Karatsuba fold
+    __m128i Hw[wide_stride];
+    __m128i Hwk[wide_stride];
+    bool wide;
+
+    // sum of X[i] * H^(n-i), i < n <= stride, reduced once
+    __m128i mul_sum(const __m128i* X, size_t n) const;
+    // nblocks / wide_stride iterations of the wide path
+    __m128i update_wide(__m128i y, const uint8_t* data, size_t nblocks) const;
+};
+
+#endif
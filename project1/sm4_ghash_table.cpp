@@ -0,0 +1,135 @@
+#include "sm4_ghash_table.h"
+
+// Reduction tables: shifting the accumulator right by k bits (multiplying by
+// x^k) pushes k low-order bits out; bit j of them stands for x^(127-j), which
+// becomes x^(127-j+k) = x^128 * x^(k-1-j) = (1 + x + x^2 + x^7) * x^(k-1-j).
+// Its image 0xE1 >> (k-1-j) lies in the top 16 bits of the high word.
+struct ghash_rem_table {
+    uint16_t v[256];
+};
+
+static constexpr ghash_rem_table make_rem(int bits) {
+    ghash_rem_table r = {};
+    for (int i = 0; i < (1 << bits); ++i) {
+        uint16_t v = 0;
+        for (int j = 0; j < bits; ++j)
+            if ((i >> j) & 1)
+                v ^= static_cast<uint16_t>(0xE100 >> (bits - 1 - j));
+        r.v[i] = v;
+    }
+    return r;
+}
+
+static constexpr ghash_rem_table rem4 = make_rem(4);
+static constexpr ghash_rem_table rem8 = make_rem(8);
+
+static_assert(rem4.v[1] == 0x1C20 && rem4.v[8] == 0xE100, "4-bit GHASH reduction table");
+
+static inline uint64_t load_be64(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; ++i)
+        v = (v << 8) | p[i];
+    return v;
+}
+
+static inline void store_be64(uint8_t* p, uint64_t v) {
+    for (int i = 0; i < 8; ++i)
+        p[i] = static_cast<uint8_t>(v >> (56 - 8 * i));
+}
+
+ghash_table::ghash_table(int bits) : bits(bits == 8 ? 8 : 4) {
+}
+
+// table[top bit] = H; halving the index multiplies by x (a right shift with
+// reduction); every other entry is the xor of its set bits' entries
+void ghash_table::init(const uint8_t H[16]) {
+    const size_t n = size_t(1) << bits;
+    table.assign(n, u128{ 0, 0 });
+    table[n / 2] = u128{ load_be64(H), load_be64(H + 8) };
+    for (size_t i = n / 4; i > 0; i >>= 1) {
+        u128 v = table[2 * i];
+        uint64_t carry = v.lo & 1;
+        v.lo = (v.lo >> 1) | (v.hi << 63);
+        v.hi = (v.hi >> 1) ^ (carry ? 0xE100000000000000ULL : 0);
+        table[i] = v;
+    }
+    for (size_t i = 2; i < n; i <<= 1)
+        for (size_t j = 1; j < i; ++j)
+            table[i + j] = u128{ table[i].hi ^ table[j].hi, table[i].lo ^ table[j].lo };
+}
+
+// X * H, Horner's rule in x^4 from the highest-degree nibble (low nibble of byte 15)
+void ghash_table::mul4(uint64_t& hi, uint64_t& lo) const {
+    const u128* t = table.data();
+    uint64_t zh = 0, zl = 0;
+    for (int k = 15; k >= 0; --k) {
+        uint8_t b = static_cast<uint8_t>(k < 8 ? hi >> (56 - 8 * k) : lo >> (120 - 8 * k));
+        for (int half = 0; half < 2; ++half) {
+            unsigned nib = half ? b >> 4 : b & 0xf;
+            unsigned rem = zl & 0xf;
+            zl = (zh << 60) | (zl >> 4);
+            zh = (zh >> 4) ^ (static_cast<uint64_t>(rem4.v[rem]) << 48);
+            zh ^= t[nib].hi;
+            zl ^= t[nib].lo;
+        }
+    }
+    hi = zh;
+    lo = zl;
+}
+
+// X * H, one byte per step
+void ghash_table::mul8(uint64_t& hi, uint64_t& lo) const {
+    const u128* t = table.data();
+    uint64_t zh = 0, zl = 0;
+    for (int k = 15; k >= 0; --k) {
+        uint8_t b = static_cast<uint8_t>(k < 8 ? hi >> (56 - 8 * k) : lo >> (120 - 8 * k));
+        unsigned rem = zl & 0xff;
+        zl = (zh << 56) | (zl >> 8);
+        zh = (zh >> 8) ^ (static_cast<uint64_t>(rem8.v[rem]) << 48);
+        zh ^= t[b].hi;
+        zl ^= t[b].lo;
+    }
+    hi = zh;
+    lo = zl;
+}
+
+void ghash_table::update(uint8_t Y[16], const uint8_t* data, size_t nblocks) const {
+    uint64_t hi = load_be64(Y), lo = load_be64(Y + 8);
+    for (size_t i = 0; i < nblocks; ++i, data += 16) {
+        hi ^= load_be64(data);
+        lo ^= load_be64(data + 8);
+        if (bits == 8)
+            mul8(hi, lo);
+        else
+            mul4(hi, lo);
+    }
+    store_be64(Y, hi);
+    store_be64(Y + 8, lo);
+}
+
+void ghash_bitwise::init(const uint8_t H[16]) {
+    hh = load_be64(H);
+    hl = load_be64(H + 8);
+}
+
+// Z accumulates V = H * x^i for every bit i of X (bit 0 = MSB of byte 0)
+void ghash_bitwise::update(uint8_t Y[16], const uint8_t* data, size_t nblocks) const {
+    uint64_t yh = load_be64(Y), yl = load_be64(Y + 8);
+    for (size_t b = 0; b < nblocks; ++b, data += 16) {
+        uint64_t xh = yh ^ load_be64(data), xl = yl ^ load_be64(data + 8);
+        uint64_t zh = 0, zl = 0, vh = hh, vl = hl;
+        for (int i = 0; i < 128; ++i) {
+            uint64_t bit = (i < 64 ? xh >> (63 - i) : xl >> (127 - i)) & 1;
+            uint64_t mask = 0 - bit;
+            zh ^= vh & mask;
+            zl ^= vl & mask;
+            uint64_t carry = 0 - (vl & 1);
+            vl = (vl >> 1) | (vh << 63);
+            vh = (vh >> 1) ^ (carry & 0xE100000000000000ULL);
+        }
+        yh = zh;
+        yl = zl;
+    }
+    store_be64(Y, yh);
+    store_be64(Y + 8, yl);
+}
@@ -0,0 +1,56 @@
+#pragma once
+#ifndef SM4_GHASH_TABLE_H
+#define SM4_GHASH_TABLE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Table-driven GHASH (Shoup's method) for hosts without PCLMULQDQ; plain C++.
+//
+// init() precomputes the multiples i*H for every 4-bit (16 entries, 256 B)
+// or 8-bit (256 entries, 4 KiB) value i. A multiplication by H then walks the
+// block a nibble or byte at a time from the high-degree end: shift the 128-bit
+// accumulator (two 64-bit words) by 4 or 8 bits, fold the bits that fall off
+// back in with a small reduction table, and xor in one table entry. The 8-bit
+// table takes half the steps of the 4-bit one for 16x the memory; which one
+// is used is chosen per instance.
+class ghash_table {
+public:
+    // bits: 4 or 8
+    explicit ghash_table(int bits = 4);
+
+    void init(const uint8_t H[16]);
+
+    // Y = (...((Y ^ X1) * H ^ X2) * H ...) * H over nblocks full 16-byte blocks,
+    // Y in GCM byte order (same interface as ghash_clmul)
+    void update(uint8_t Y[16], const uint8_t* data, size_t nblocks) const;
+
+    int tableBits() const { return bits; }
+
+private:
+    struct u128 {
+        uint64_t hi, lo;
+    };
+
+    int bits;
+    std::vector<u128> table;  // table[i] = i * H, 16 or 256 entries
+
+    void mul4(uint64_t& hi, uint64_t& lo) const;
+    void mul8(uint64_t& hi, uint64_t& lo) const;
+};
+
+// Bit-serial GHASH (SP 800-38D, algorithm 1): 128 shift-and-xor steps per
+// block, on two 64-bit words. No tables and no special instructions; the
+// baseline the other GHASH implementations are measured against.
+class ghash_bitwise {
+public:
+    void init(const uint8_t H[16]);
+    // same interface as ghash_table / ghash_clmul
+    void update(uint8_t Y[16], const uint8_t* data, size_t nblocks) const;
+
+private:
+    uint64_t hh = 0, hl = 0;
+};
+
+#endif
@@ -0,0 +1,107 @@
+#include "sm4_gmac.h"
+#include <cstring>
+#include <emmintrin.h>
+
+static inline void put_be64(uint8_t* p, uint64_t v) {
+    for (int i = 0; i < 8; ++i)
+        p[i] = static_cast<uint8_t>(v >> (56 - 8 * i));
+}
+
+sm4_gmac::sm4_gmac(const uint8_t key[16]) {
+    cipher.setKey(key);
+    uint8_t H[16] = { 0 };
+    cipher.encryptBlock(H, H);
+    gh.init(H);
+}
+
+// Schedule and H come precomputed from sm4_key_cache
+sm4_gmac::sm4_gmac(const sm4_expanded_key& xk) {
+    cipher.setExpandedKey(xk);
+    gh.init(xk.H);
+}
+
+void sm4_gmac::init_j0(const uint8_t* iv, size_t iv_len, uint8_t j0[16]) const {
+    if (iv_len == 12) {
+        std::memcpy(j0, iv, 12);
+        j0[12] = 0x00; j0[13] = 0x00; j0[14] = 0x00; j0[15] = 0x01;
+        return;
+    }
+    // J0 = GHASH(IV || 0-pad || [0]64 || [len(IV)]64)
+    __m128i s = gh.update(_mm_setzero_si128(), iv, iv_len / 16);
+    uint8_t block[16] = { 0 };
+    if (iv_len % 16) {
+        std::memcpy(block, iv + iv_len / 16 * 16, iv_len % 16);
+        s = gh.update(s, block, 1);
+    }
+    std::memset(block, 0, 8);
+    put_be64(block + 8, static_cast<uint64_t>(iv_len) * 8);
+    s = gh.update(s, block, 1);
+    ghash_clmul::store_state(s, j0);
+}
+
+void sm4_gmac::init(const uint8_t* iv, size_t iv_len) {
+    init_j0(iv, iv_len, J0);
+    y = _mm_setzero_si128();
+    total = 0;
+}
+
+void sm4_gmac::update(const uint8_t* data, size_t len) {
+    size_t pos = total % 16;
+    total += len;
+
+    if (pos) {
+        size_t n = len < 16 - pos ? len : 16 - pos;
+        std::memcpy(partial + pos, data, n);
+        data += n;
+        len -= n;
+        if (pos + n < 16)
+            return;
+        y = gh.update(y, partial, 1);
+    }
+    y = gh.update(y, data, len / 16);
+    std::memcpy(partial, data + len / 16 * 16, len % 16);
+}
+
+// s covers the input with its last block already padded:
+// tag = GHASH(... || [len(A)]64 || [0]64) ^ E(K, J0)
+void sm4_gmac::tag_of(const uint8_t j0[16], __m128i s, uint64_t len, uint8_t tag[16]) const {
+    uint8_t len_block[16] = { 0 };
+    put_be64(len_block, len * 8);
+    s = gh.update(s, len_block, 1);
+    ghash_clmul::store_state(s, tag);
+
+    uint8_t Ek0[16];
+    cipher.encryptBlock(j0, Ek0);
+    for (int i = 0; i < 16; ++i)
+        tag[i] ^= Ek0[i];
+}
+
+void sm4_gmac::finish(uint8_t tag[16]) {
+    size_t pos = total % 16;
+    if (pos) {
+        std::memset(partial + pos, 0, 16 - pos);
+        y = gh.update(y, partial, 1);
+    }
+    tag_of(J0, y, total, tag);
+}
+
+bool sm4_gmac::finish_verify(const uint8_t tag[16]) {
+    uint8_t computed[16];
+    finish(computed);
+    uint8_t diff = 0;
+    for (int i = 0; i < 16; ++i)
+        diff |= computed[i] ^ tag[i];
+    return diff == 0;
+}
+
+void sm4_gmac::mac(const uint8_t* iv, size_t iv_len, const uint8_t* data, size_t len, uint8_t tag[16]) const {
+    uint8_t j0[16];
+    init_j0(iv, iv_len, j0);
+    __m128i s = gh.update(_mm_setzero_si128(), data, len / 16);
+    if (len % 16) {
+        uint8_t last[16] = { 0 };
+        std::memcpy(last, data + len / 16 * 16, len % 16);
+        s = gh.update(s, last, 1);
+    }
+    tag_of(j0, s, len, tag);
+}
@@ -0,0 +1,51 @@
+#pragma once
+#ifndef SM4_GMAC_H
+#define SM4_GMAC_H
+
+#include <cstdint>
+#include <cstddef>
+#include <wmmintrin.h>
+#include "sm4_aesni.h"
+#include "sm4_ghash.h"
+
+// Note: no -m flags needed; the code here is SSE2, the sm4_aesni and
+// ghash_clmul kernels carry their own target(...) (GCC/Clang)
+
+// SM4-GMAC (NIST SP 800-38D): GCM with the whole input as AAD and no
+// plaintext, for integrity-only data. No keystream is generated; the cost is
+// GHASH alone (ghash_clmul, 8 blocks per reduction) plus one SM4 block per tag.
+//
+//   sm4_gmac m(key);
+//   m.init(iv, 12);
+//   m.update(data, n);                 // any number of calls, any chunk sizes
+//   m.finish(tag);                     // or m.finish_verify(tag)
+//
+// mac() does the same in one const call and may be used from several threads
+// on one object; init/update/finish keep per-message state.
+class sm4_gmac {
+public:
+    explicit sm4_gmac(const uint8_t key[16]);
+    explicit sm4_gmac(const sm4_expanded_key& xk);
+
+    void init(const uint8_t* iv, size_t iv_len);
+    void update(const uint8_t* data, size_t len);
+    void finish(uint8_t tag[16]);
+    // constant-time comparison with the expected tag
+    bool finish_verify(const uint8_t tag[16]);
+
+    void mac(const uint8_t* iv, size_t iv_len, const uint8_t* data, size_t len, uint8_t tag[16]) const;
+
+private:
+    sm4_aesni cipher;
+    ghash_clmul gh;
+    uint8_t J0[16] = {};
+
+    __m128i y = __m128i();  // GHASH accumulator, byte-reflected
+    uint8_t partial[16];    // unfinished input block
+    uint64_t total = 0;     // bytes hashed so far
+
+    void init_j0(const uint8_t* iv, size_t iv_len, uint8_t j0[16]) const;
+    void tag_of(const uint8_t j0[16], __m128i s, uint64_t len, uint8_t tag[16]) const;
+};
+
+#endif
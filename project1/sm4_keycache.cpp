@@ -0,0 +1,123 @@
+#include "sm4_keycache.h"
+#include "sm4.h"
+#include <cstring>
+#include <iterator>
+#include <random>
+
+// Key material must not linger in freed memory
+static void wipe_delete(sm4_expanded_key* p) {
+    volatile uint8_t* b = reinterpret_cast<volatile uint8_t*>(p);
+    for (size_t i = 0; i < sizeof(*p); ++i)
+        b[i] = 0;
+    delete p;
+}
+
+static uint64_t random_seed() {
+    std::random_device rd;
+    return ((uint64_t)rd() << 32) ^ rd();
+}
+
+sm4_key_cache::sm4_key_cache(size_t capacity)
+    : cap(capacity ? capacity : 1), seed(random_seed()) {
+}
+
+sm4_key_cache& sm4_key_cache::shared() {
+    static sm4_key_cache cache;
+    return cache;
+}
+
+void sm4_key_cache::expand(const uint8_t key[16], sm4_expanded_key& xk) {
+    std::memcpy(xk.key, key, 16);
+    sm4::expandKey(key, xk.rk);
+    for (int i = 0; i < 32; ++i) {
+        xk.rk_rev[i] = xk.rk[31 - i];
+        for (int j = 0; j < 4; ++j) {
+            xk.rk_x4[i][j] = xk.rk[i];
+            xk.rk_rev_x4[i][j] = xk.rk[31 - i];
+        }
+    }
+
+    sm4 c;
+    c.setExpandedKey(xk);
+    uint8_t zero[16] = { 0 };
+    c.encryptBlock(zero, xk.H);
+}
+
+// Seeded so that tenants cannot steer keys into one bucket
+uint64_t sm4_key_cache::fingerprint(const uint8_t key[16]) const {
+    uint64_t a, b;
+    std::memcpy(&a, key, 8);
+    std::memcpy(&b, key + 8, 8);
+    uint64_t h = seed ^ a;
+    h = (h ^ (h >> 33)) * 0xff51afd7ed558ccdULL;
+    h ^= b;
+    h = (h ^ (h >> 33)) * 0xc4ceb9fe1a85ec53ULL;
+    return h ^ (h >> 33);
+}
+
+// caller holds the lock
+sm4_key_cache::lru_list::iterator sm4_key_cache::find(uint64_t fp, const uint8_t key[16]) {
+    auto range = index.equal_range(fp);
+    for (auto it = range.first; it != range.second; ++it)
+        if (std::memcmp((*it->second)->key, key, 16) == 0)
+            return it->second;
+    return lru.end();
+}
+
+std::shared_ptr<const sm4_expanded_key> sm4_key_cache::get(const uint8_t key[16]) {
+    uint64_t fp = fingerprint(key);
+    {
+        std::lock_guard<std::mutex> g(lock);
+        lru_list::iterator it = find(fp, key);
+        if (it != lru.end()) {
+            ++hits;
+            lru.splice(lru.begin(), lru, it);
+            return *it;
+        }
+        ++misses;
+    }
+
+    // expand outside the lock so a miss does not stall lookups of other keys
+    std::shared_ptr<sm4_expanded_key> xk(new sm4_expanded_key, wipe_delete);
+    expand(key, *xk);
+
+    std::lock_guard<std::mutex> g(lock);
+    lru_list::iterator it = find(fp, key);
+    if (it != lru.end()) {
+        // another thread inserted the same key meanwhile
+        lru.splice(lru.begin(), lru, it);
+        return *it;
+    }
+    lru.push_front(xk);
+    index.emplace(fp, lru.begin());
+
+    while (lru.size() > cap) {
+        lru_list::iterator last = std::prev(lru.end());
+        auto range = index.equal_range(fingerprint((*last)->key));
+        for (auto e = range.first; e != range.second; ++e) {
+            if (e->second == last) {
+                index.erase(e);
+                break;
+            }
+        }
+        lru.pop_back();
+        ++evictions;
+    }
+    return xk;
+}
+
+sm4_key_cache::stats sm4_key_cache::counters() const {
+    std::lock_guard<std::mutex> g(lock);
+    stats s;
+    s.hits = hits;
+    s.misses = misses;
+    s.evictions = evictions;
+    s.size = lru.size();
+    return s;
+}
+
+void sm4_key_cache::clear() {
+    std::lock_guard<std::mutex> g(lock);
+    index.clear();
+    lru.clear();
+}
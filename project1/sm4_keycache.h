@@ -0,0 +1,71 @@
+#pragma once
+#ifndef SM4_KEYCACHE_H
+#define SM4_KEYCACHE_H
+
+#include "sm4_core.h"
+#include <cstdint>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+// Thread-safe LRU cache of expanded SM4 keys.
+//
+// get() returns the sm4_expanded_key for a 16-byte key, expanding it on a
+// miss. Entries are looked up by a seeded 64-bit fingerprint of the key and
+// confirmed by comparing the full key, so fingerprint collisions only cost a
+// compare. Returned entries are shared_ptrs: evicting an entry never pulls it
+// from under a thread that still uses it. Key material is wiped when the last
+// reference goes away.
+//
+//   std::shared_ptr<const sm4_expanded_key> xk = sm4_key_cache::shared().get(key);
+//   sm4_aesni c;
+//   c.setExpandedKey(*xk);
+//   sm4gcm gcm(*xk);
+//   gcm.seal(iv, 12, pt, len, aad, aad_len, ct, tag);
+class sm4_key_cache {
+public:
+    struct stats {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+        size_t size;
+    };
+
+    explicit sm4_key_cache(size_t capacity = 4096);
+
+    sm4_key_cache(const sm4_key_cache&) = delete;
+    sm4_key_cache& operator=(const sm4_key_cache&) = delete;
+
+    std::shared_ptr<const sm4_expanded_key> get(const uint8_t key[16]);
+
+    stats counters() const;
+    size_t capacity() const { return cap; }
+    void clear();
+
+    // process-wide instance
+    static sm4_key_cache& shared();
+
+    // fill every field of xk for key (what a miss does)
+    static void expand(const uint8_t key[16], sm4_expanded_key& xk);
+
+private:
+    typedef std::shared_ptr<const sm4_expanded_key> entry;
+    typedef std::list<entry> lru_list;  // front = most recently used
+
+    uint64_t fingerprint(const uint8_t key[16]) const;
+    lru_list::iterator find(uint64_t fp, const uint8_t key[16]);
+
+    const size_t cap;
+    const uint64_t seed;
+
+    mutable std::mutex lock;
+    lru_list lru;
+    std::unordered_multimap<uint64_t, lru_list::iterator> index;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+};
+
+#endif
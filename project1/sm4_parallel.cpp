@@ -0,0 +1,153 @@
+#include "sm4_parallel.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Logical CPUs this process may run on (taskset, cgroup cpusets, containers),
+// in ascending order; empty where the mask cannot be read
+static std::vector<size_t> allowed_cpus() {
+    std::vector<size_t> cpus;
+#if defined(_WIN32)
+    DWORD_PTR proc = 0, sys = 0;
+    if (GetProcessAffinityMask(GetCurrentProcess(), &proc, &sys))
+        for (size_t cpu = 0; cpu < 8 * sizeof(DWORD_PTR); ++cpu)
+            if (proc & ((DWORD_PTR)1 << cpu))
+                cpus.push_back(cpu);
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0)
+        for (size_t cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            if (CPU_ISSET(cpu, &set))
+                cpus.push_back(cpu);
+#endif
+    return cpus;
+}
+
+// Pin the calling thread to one logical CPU; best effort, ignored where unsupported
+static void pin_to_cpu(size_t cpu) {
+#if defined(_WIN32)
+    if (cpu < 8 * sizeof(DWORD_PTR))
+        SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu);
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)cpu;
+#endif
+}
+
+sm4_thread_pool::sm4_thread_pool(size_t threads, bool pin) {
+    std::vector<size_t> cpus = allowed_cpus();
+    size_t hw = cpus.empty() ? std::thread::hardware_concurrency() : cpus.size();
+    if (hw == 0) hw = 1;
+    if (threads == 0) threads = hw;
+    // one allowed CPU per thread or none: stacking workers on a core is worse than not pinning
+    if (threads > cpus.size())
+        pin = false;
+
+    slots.reset(new slot[threads]);
+    for (size_t i = 0; i < threads; ++i) {
+        slots[i].next.store(0, std::memory_order_relaxed);
+        slots[i].end = 0;
+    }
+
+    // the caller is participant 0 and is left unpinned; worker i takes the
+    // i-th allowed CPU
+    for (size_t i = 1; i < threads; ++i) {
+        size_t cpu = pin ? cpus[i] : 0;
+        workers.emplace_back([this, i, pin, cpu]() {
+            if (pin)
+                pin_to_cpu(cpu);
+            worker_main(i);
+        });
+    }
+}
+
+sm4_thread_pool::~sm4_thread_pool() {
+    {
+        std::lock_guard<std::mutex> g(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& t : workers)
+        t.join();
+}
+
+sm4_thread_pool& sm4_thread_pool::shared() {
+    static sm4_thread_pool pool;
+    return pool;
+}
+
+void sm4_thread_pool::worker_main(size_t id) {
+    uint64_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> g(lock);
+            wake.wait(g, [&] { return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen = generation;
+        }
+        work(id);
+        {
+            std::lock_guard<std::mutex> g(lock);
+            if (--active == 0)
+                done.notify_one();
+        }
+    }
+}
+
+// Drain the own range first, then steal from the others. fetch_add hands every
+// chunk to exactly one thread; an overshoot past end just means "empty".
+void sm4_thread_pool::work(size_t id) {
+    const size_t p = size();
+    for (size_t k = 0; k < p; ++k) {
+        slot& s = slots[(id + k) % p];
+        for (;;) {
+            size_t c = s.next.fetch_add(1, std::memory_order_relaxed);
+            if (c >= s.end)
+                break;
+            size_t b = c * job_chunk;
+            size_t e = b + job_chunk < job_n ? b + job_chunk : job_n;
+            (*job)(b, e);
+        }
+    }
+}
+
+void sm4_thread_pool::run(size_t n, size_t chunk, const std::function<void(size_t, size_t)>& fn) {
+    if (n == 0)
+        return;
+    if (chunk == 0)
+        chunk = 1;
+    std::lock_guard<std::mutex> serial(run_lock);
+
+    const size_t p = size();
+    const size_t chunks = (n + chunk - 1) / chunk;
+    for (size_t i = 0; i < p; ++i) {
+        slots[i].next.store(chunks * i / p, std::memory_order_relaxed);
+        slots[i].end = chunks * (i + 1) / p;
+    }
+
+    {
+        std::lock_guard<std::mutex> g(lock);
+        job = &fn;
+        job_n = n;
+        job_chunk = chunk;
+        active = workers.size();
+        ++generation;
+    }
+    wake.notify_all();
+
+    work(0);
+
+    std::unique_lock<std::mutex> g(lock);
+    done.wait(g, [&] { return active == 0; });
+    job = nullptr;
+}
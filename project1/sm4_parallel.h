@@ -0,0 +1,144 @@
+#pragma once
+#ifndef SM4_PARALLEL_H
+#define SM4_PARALLEL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Chunk handed to a worker at a time: 1024 blocks = 16 KiB in + 16 KiB out,
+// which stays inside L1d/L2 while the chunk is processed.
+const size_t sm4_parallel_chunk_blocks = 1024;
+
+// Persistent worker pool for bulk SM4.
+//
+// Threads are created once (optionally pinned one per core) and sleep between
+// jobs. run() splits [0, n) into chunks, deals them out as contiguous ranges,
+// one per worker plus the calling thread, and lets a thread that finishes its
+// own range steal chunks from the others, so a core slowed by other load does
+// not hold up the whole job.
+//
+// run() calls are serialised; a job must not call run() on the same pool.
+class sm4_thread_pool {
+public:
+    // threads = 0: one per CPU in the process affinity mask (the caller counts
+    // as one). pin: worker i is bound to the i-th allowed CPU; skipped when
+    // there are more threads than allowed CPUs
+    explicit sm4_thread_pool(size_t threads = 0, bool pin = true);
+    ~sm4_thread_pool();
+
+    sm4_thread_pool(const sm4_thread_pool&) = delete;
+    sm4_thread_pool& operator=(const sm4_thread_pool&) = delete;
+
+    // threads taking part in a job, the caller included
+    size_t size() const { return workers.size() + 1; }
+
+    // job(begin, end) for consecutive item ranges of at most chunk items
+    // covering [0, n); returns when all of them are done
+    void run(size_t n, size_t chunk, const std::function<void(size_t, size_t)>& job);
+
+    // process-wide pool, created on first use
+    static sm4_thread_pool& shared();
+
+private:
+    // one per thread, on its own cache line; chunks [next, end) not yet taken
+    struct alignas(64) slot {
+        std::atomic<size_t> next;
+        size_t end;
+    };
+
+    void worker_main(size_t id);
+    void work(size_t id);
+
+    std::vector<std::thread> workers;
+    std::unique_ptr<slot[]> slots;
+
+    std::mutex run_lock;
+
+    std::mutex lock;
+    std::condition_variable wake, done;
+    uint64_t generation = 0;
+    size_t active = 0;
+    bool stopping = false;
+
+    // current job
+    const std::function<void(size_t, size_t)>* job = nullptr;
+    size_t job_n = 0;
+    size_t job_chunk = 0;
+};
+
+// ---------------- bulk modes over any backend ----------------
+// Cipher is any class with const encryptBlocks/decryptBlocks(in, out, nblocks):
+// sm4, sm4_table, sm4_aesni, sm4_vaes, sm4_gfni, sm4_bitslice, sm4_engine, ...
+
+template <class Cipher>
+void parallel_encrypt_ecb(const Cipher& c, const uint8_t* in, uint8_t* out, size_t nblocks,
+    sm4_thread_pool& pool = sm4_thread_pool::shared()) {
+    if (nblocks <= sm4_parallel_chunk_blocks) {
+        c.encryptBlocks(in, out, nblocks);
+        return;
+    }
+    pool.run(nblocks, sm4_parallel_chunk_blocks, [&](size_t b, size_t e) {
+        c.encryptBlocks(in + 16 * b, out + 16 * b, e - b);
+    });
+}
+
+template <class Cipher>
+void parallel_decrypt_ecb(const Cipher& c, const uint8_t* in, uint8_t* out, size_t nblocks,
+    sm4_thread_pool& pool = sm4_thread_pool::shared()) {
+    if (nblocks <= sm4_parallel_chunk_blocks) {
+        c.decryptBlocks(in, out, nblocks);
+        return;
+    }
+    pool.run(nblocks, sm4_parallel_chunk_blocks, [&](size_t b, size_t e) {
+        c.decryptBlocks(in + 16 * b, out + 16 * b, e - b);
+    });
+}
+
+// counter blocks ctr + first, ctr + first + 1, ... (128-bit big-endian add)
+inline void sm4_ctr_blocks(const uint8_t ctr[16], size_t first, size_t n, uint8_t* blocks) {
+    uint64_t hi = 0, lo = 0;
+    for (int i = 0; i < 8; ++i) {
+        hi = (hi << 8) | ctr[i];
+        lo = (lo << 8) | ctr[8 + i];
+    }
+    lo += first;
+    if (lo < first) ++hi;
+    for (size_t i = 0; i < n; ++i, ++lo) {
+        if (lo == 0 && i != 0) ++hi;
+        uint8_t* p = blocks + 16 * i;
+        for (int j = 0; j < 8; ++j) {
+            p[j] = (uint8_t)(hi >> (56 - 8 * j));
+            p[8 + j] = (uint8_t)(lo >> (56 - 8 * j));
+        }
+    }
+}
+
+// CTR mode (NIST SP 800-38A, whole 128-bit counter incremented), len in
+// bytes, any length. Encryption and decryption are the same operation.
+template <class Cipher>
+void parallel_ctr(const Cipher& c, const uint8_t iv[16], const uint8_t* in, uint8_t* out, size_t len,
+    sm4_thread_pool& pool = sm4_thread_pool::shared()) {
+    size_t nblocks = (len + 15) / 16;
+    auto job = [&](size_t b, size_t e) {
+        uint8_t ks[16 * sm4_parallel_chunk_blocks];
+        sm4_ctr_blocks(iv, b, e - b, ks);
+        c.encryptBlocks(ks, ks, e - b);
+        size_t off = 16 * b, bytes = (16 * e < len ? 16 * e : len) - off;
+        for (size_t i = 0; i < bytes; ++i)
+            out[off + i] = in[off + i] ^ ks[i];
+    };
+    if (nblocks <= sm4_parallel_chunk_blocks)
+        job(0, nblocks);
+    else
+        pool.run(nblocks, sm4_parallel_chunk_blocks, job);
+}
+
+#endif
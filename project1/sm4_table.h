@@ -4,30 +4,50 @@
 #define SM4_TABLE_H
 
 #include <cstdint>
+#include "sm4_core.h"
+
+// T-table entry for byte b at bit offset shift: L(S(b) << shift).
+// L commutes with rotation, so the tables for shifts 16/8/0 are T0
+// rotated right by 8/16/24.
+static constexpr sm4_word_table sm4_make_ttable(int shift) {
+    sm4_word_table t = { {} };
+    for (int i = 0; i < 256; ++i)
+        t.v[i] = sm4_linear_rotl::L((uint32_t)sm4_consts::Sbox[i] << shift);
+    return t;
+}
+
+// T(x) = T0[x0] ^ T1[x1] ^ T2[x2] ^ T3[x3], L already folded into the tables.
+// Four 1 KiB tables, built at compile time (.rodata, no init at startup).
+struct sm4_ttable_policy {
+    static constexpr sm4_word_table T0 = sm4_make_ttable(24);
+    static constexpr sm4_word_table T1 = sm4_make_ttable(16);
+    static constexpr sm4_word_table T2 = sm4_make_ttable(8);
+    static constexpr sm4_word_table T3 = sm4_make_ttable(0);
+
+    static inline uint32_t tau(uint32_t x) {
+        return T0[(x >> 24) & 0xFF] ^ T1[(x >> 16) & 0xFF] ^ T2[(x >> 8) & 0xFF] ^ T3[x & 0xFF];
+    }
+};
+
+// Same lookup with only T0 (1 KiB), the other three are rotations of it.
+// Costs three rotates per round, leaves 3 KiB more of L1 to whatever
+// shares the core.
+struct sm4_ttable_compact_policy {
+    static constexpr sm4_word_table T0 = sm4_make_ttable(24);
+
+    static inline uint32_t tau(uint32_t x) {
+        return T0[(x >> 24) & 0xFF] ^ sm4_rotl(T0[(x >> 16) & 0xFF], 24) ^
+            sm4_rotl(T0[(x >> 8) & 0xFF], 16) ^ sm4_rotl(T0[x & 0xFF], 8);
+    }
+};
+
+// Footprint is the caller's choice: sm4_table (4 KiB of tables) or
+// sm4_table_compact (1 KiB). Both are plain objects with no shared state to
+// initialize, so construction is free and thread-safe.
+class sm4_table : public sm4_core<sm4_ttable_policy, sm4_linear_none> {
+};
 
-class sm4_table {
-public:
-    sm4_table();
-    void setKey(const uint8_t key[16]);
-    void encryptBlock(const uint8_t in[16], uint8_t out[16]);
-    void decryptBlock(const uint8_t in[16], uint8_t out[16]);
-
-private:
-    uint32_t rk[32];
-
-    uint32_t F(uint32_t x0, uint32_t x1, uint32_t x2, uint32_t x3, uint32_t rk);
-    uint32_t T(uint32_t x);
-    static uint32_t L(uint32_t x);
-    static uint32_t tau(uint32_t x);
-
-    static uint8_t Sbox[256];
-    static const uint32_t FK[4];
-    static const uint32_t CK[32];
-
-    static uint32_t T0[256], T1[256], T2[256], T3[256];
-    static bool ttable_initialized;
-    static void initTTable();
-    uint32_t T_table(uint32_t x);
+class sm4_table_compact : public sm4_core<sm4_ttable_compact_policy, sm4_linear_none> {
 };
 
 #endif
@@ -0,0 +1,296 @@
+#include "sm4_vaes.h"
+#include "sm4_engine.h"
+
+void sm4_vaes::encryptBlocks8(const uint8_t* plaintext, uint8_t* ciphertext) const {
+    SM4_VAES_do8(plaintext, ciphertext, rk, 0);
+}
+
+void sm4_vaes::decryptBlocks8(const uint8_t* ciphertext, uint8_t* plaintext) const {
+    SM4_VAES_do8(ciphertext, plaintext, rk, 1);
+}
+
+void sm4_vaes::encryptBlocks16(const uint8_t* plaintext, uint8_t* ciphertext) const {
+    SM4_VAES_do16(plaintext, ciphertext, rk, 0);
+}
+
+void sm4_vaes::decryptBlocks16(const uint8_t* ciphertext, uint8_t* plaintext) const {
+    SM4_VAES_do16(ciphertext, plaintext, rk, 1);
+}
+
+void sm4_vaes::encryptBlocks(const uint8_t* in, uint8_t* out, size_t nblocks) const {
+    size_t i = 0;
+    for (; nblocks - i >= 16; i += 16)
+        SM4_VAES_do16(in + 16 * i, out + 16 * i, rk, 0);
+    for (; i < nblocks; i += 8)
+        SM4_VAES_do8(in + 16 * i, out + 16 * i, rk, 0, nblocks - i < 8 ? nblocks - i : 8);
+}
+
+void sm4_vaes::decryptBlocks(const uint8_t* in, uint8_t* out, size_t nblocks) const {
+    size_t i = 0;
+    for (; nblocks - i >= 16; i += 16)
+        SM4_VAES_do16(in + 16 * i, out + 16 * i, rk, 1);
+    for (; i < nblocks; i += 8)
+        SM4_VAES_do8(in + 16 * i, out + 16 * i, rk, 1, nblocks - i < 8 ? nblocks - i : 8);
+}
+
+// Dword mask for register j of a partial load: it covers blocks 2j and 2j+1,
+// only the first n blocks of the group are touched in memory.
+static inline SM4_TARGET("avx2,vaes") __m256i tail_mask(size_t n, int j) {
+    return _mm256_cmpgt_epi32(_mm256_set1_epi32((int)(4 * n) - 8 * j),
+        _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+}
+
+// Load 8 blocks and transpose them so that X[j] holds word j of every block.
+// The unpack instructions work per 128-bit lane, so the low lane carries
+// blocks 0,2,4,6 and the high lane blocks 1,3,5,7; the inverse transpose on
+// store puts them back in order.
+static inline SM4_TARGET("avx2,vaes") void load8(const uint8_t* in, __m256i X[4], size_t n = 8) {
+    const __m256i vindex = _mm256_setr_epi8(
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    __m256i Tmp[4];
+    if (n == 8) {
+        Tmp[0] = _mm256_loadu_si256((const __m256i*)in + 0);
+        Tmp[1] = _mm256_loadu_si256((const __m256i*)in + 1);
+        Tmp[2] = _mm256_loadu_si256((const __m256i*)in + 2);
+        Tmp[3] = _mm256_loadu_si256((const __m256i*)in + 3);
+    }
+    else {
+        for (int j = 0; j < 4; ++j)
+            Tmp[j] = _mm256_maskload_epi32((const int*)in + 8 * j, tail_mask(n, j));
+    }
+
+    X[0] = _mm256_shuffle_epi8(MM256_PACK0_EPI32(Tmp[0], Tmp[1], Tmp[2], Tmp[3]), vindex);
+    X[1] = _mm256_shuffle_epi8(MM256_PACK1_EPI32(Tmp[0], Tmp[1], Tmp[2], Tmp[3]), vindex);
+    X[2] = _mm256_shuffle_epi8(MM256_PACK2_EPI32(Tmp[0], Tmp[1], Tmp[2], Tmp[3]), vindex);
+    X[3] = _mm256_shuffle_epi8(MM256_PACK3_EPI32(Tmp[0], Tmp[1], Tmp[2], Tmp[3]), vindex);
+}
+
+static inline SM4_TARGET("avx2,vaes") void store8(uint8_t* out, __m256i X[4], size_t n = 8) {
+    const __m256i vindex = _mm256_setr_epi8(
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+        3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    X[0] = _mm256_shuffle_epi8(X[0], vindex);
+    X[1] = _mm256_shuffle_epi8(X[1], vindex);
+    X[2] = _mm256_shuffle_epi8(X[2], vindex);
+    X[3] = _mm256_shuffle_epi8(X[3], vindex);
+
+    __m256i Tmp[4];
+    Tmp[0] = MM256_PACK0_EPI32(X[3], X[2], X[1], X[0]);
+    Tmp[1] = MM256_PACK1_EPI32(X[3], X[2], X[1], X[0]);
+    Tmp[2] = MM256_PACK2_EPI32(X[3], X[2], X[1], X[0]);
+    Tmp[3] = MM256_PACK3_EPI32(X[3], X[2], X[1], X[0]);
+    for (int j = 0; j < 4; ++j) {
+        if (n == 8)
+            _mm256_storeu_si256((__m256i*)out + j, Tmp[j]);
+        else
+            _mm256_maskstore_epi32((int*)out + 8 * j, tail_mask(n, j), Tmp[j]);
+    }
+}
+
+SM4_TARGET("avx2,vaes") void sm4_vaes::SM4_VAES_do8(const uint8_t* in, uint8_t* out, const uint32_t* rk, int enc, size_t n) {
+    __m256i X[4], Tmp;
+    load8(in, X, n);
+
+    for (int i = 0; i < 32; i++) {
+        __m256i k = _mm256_set1_epi32(enc == 0 ? rk[i] : rk[31 - i]);
+        Tmp = MM256_XOR4(X[1], X[2], X[3], k);
+        Tmp = MM256_XOR2(X[0], SM4_T(Tmp));
+        X[0] = X[1]; X[1] = X[2]; X[2] = X[3]; X[3] = Tmp;
+    }
+
+    store8(out, X, n);
+}
+
+// Two groups in flight: the S-box of one group hides the latency of the other.
+SM4_TARGET("avx2,vaes") void sm4_vaes::SM4_VAES_do16(const uint8_t* in, uint8_t* out, const uint32_t* rk, int enc) {
+    __m256i X[4], Y[4], TmpX, TmpY;
+    load8(in, X);
+    load8(in + 128, Y);
+
+    for (int i = 0; i < 32; i++) {
+        __m256i k = _mm256_set1_epi32(enc == 0 ? rk[i] : rk[31 - i]);
+        TmpX = MM256_XOR4(X[1], X[2], X[3], k);
+        TmpY = MM256_XOR4(Y[1], Y[2], Y[3], k);
+        TmpX = MM256_XOR2(X[0], SM4_T(TmpX));
+        TmpY = MM256_XOR2(Y[0], SM4_T(TmpY));
+        X[0] = X[1]; X[1] = X[2]; X[2] = X[3]; X[3] = TmpX;
+        Y[0] = Y[1]; Y[1] = Y[2]; Y[2] = Y[3]; Y[3] = TmpY;
+    }
+
+    store8(out, X);
+    store8(out + 128, Y);
+}
+
+// load8 leaves blocks 0,2,4,6 in the low lane and 1,3,5,7 in the high one;
+// round keys given in block order are permuted the same way.
+static inline SM4_TARGET("avx2,vaes") __m256i lane_keys(const uint32_t* k) {
+    return _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i*)k),
+        _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7));
+}
+
+SM4_TARGET("avx2,vaes") void sm4_vaes::SM4_VAES_lanes8(const uint8_t* in, uint8_t* out, const uint32_t (*rkx)[8], size_t n) {
+    __m256i X[4], Tmp;
+    load8(in, X, n);
+
+    for (int i = 0; i < 32; i++) {
+        Tmp = MM256_XOR4(X[1], X[2], X[3], lane_keys(rkx[i]));
+        Tmp = MM256_XOR2(X[0], SM4_T(Tmp));
+        X[0] = X[1]; X[1] = X[2]; X[2] = X[3]; X[3] = Tmp;
+    }
+
+    store8(out, X, n);
+}
+
+SM4_TARGET("avx2,vaes") void sm4_vaes::SM4_VAES_lanes16(const uint8_t* in, uint8_t* out, const uint32_t (*rkx0)[8], const uint32_t (*rkx1)[8]) {
+    __m256i X[4], Y[4], TmpX, TmpY;
+    load8(in, X);
+    load8(in + 128, Y);
+
+    for (int i = 0; i < 32; i++) {
+        TmpX = MM256_XOR4(X[1], X[2], X[3], lane_keys(rkx0[i]));
+        TmpY = MM256_XOR4(Y[1], Y[2], Y[3], lane_keys(rkx1[i]));
+        TmpX = MM256_XOR2(X[0], SM4_T(TmpX));
+        TmpY = MM256_XOR2(Y[0], SM4_T(TmpY));
+        X[0] = X[1]; X[1] = X[2]; X[2] = X[3]; X[3] = TmpX;
+        Y[0] = Y[1]; Y[1] = Y[2]; Y[2] = Y[3]; Y[3] = TmpY;
+    }
+
+    store8(out, X);
+    store8(out + 128, Y);
+}
+
+void sm4_vaes::encryptBlocksMultiKey(const uint32_t* const rks[], const uint8_t* in, uint8_t* out, size_t nblocks) {
+    cryptBlocksMultiKey(rks, in, out, nblocks, false);
+}
+
+void sm4_vaes::decryptBlocksMultiKey(const uint32_t* const rks[], const uint8_t* in, uint8_t* out, size_t nblocks) {
+    cryptBlocksMultiKey(rks, in, out, nblocks, true);
+}
+
+void sm4_vaes::cryptBlocksInterleaved(const uint32_t (*rkx)[8], const uint8_t* in, uint8_t* out, size_t n) {
+    SM4_VAES_lanes8(in, out, rkx, n);
+}
+
+// Gather rks[] into [32][8] tables (missing lanes zero), two groups per call when possible
+void sm4_vaes::cryptBlocksMultiKey(const uint32_t* const rks[], const uint8_t* in, uint8_t* out, size_t nblocks, bool dec) {
+    alignas(32) uint32_t rkx[2][32][8];
+    for (size_t i = 0; i < nblocks; i += 16) {
+        size_t n = nblocks - i < 16 ? nblocks - i : 16;
+        for (int r = 0; r < 32; ++r)
+            for (size_t j = 0; j < 16; ++j)
+                rkx[j / 8][r][j % 8] = j < n ? rks[i + j][dec ? 31 - r : r] : 0;
+        if (n == 16) {
+            SM4_VAES_lanes16(in + 16 * i, out + 16 * i, rkx[0], rkx[1]);
+        }
+        else {
+            SM4_VAES_lanes8(in + 16 * i, out + 16 * i, rkx[0], n < 8 ? n : 8);
+            if (n > 8)
+                SM4_VAES_lanes8(in + 16 * (i + 8), out + 16 * (i + 8), rkx[1], n - 8);
+        }
+    }
+}
+
+void sm4_vaes::setKeys(const uint8_t keys[][16], size_t n, uint32_t (*rkx)[32][8], uint32_t (*rkx_dec)[32][8]) {
+    for (size_t i = 0; i < n; i += 16) {
+        size_t m = n - i < 16 ? n - i : 16;
+        SM4_VAES_keys(keys[i], m, rkx + i / 8, rkx_dec ? rkx_dec + i / 8 : nullptr);
+    }
+}
+
+// The key schedule has the shape of the cipher rounds with L'(x) = x ^ (x <<< 13) ^ (x <<< 23).
+// Keys are contiguous 16-byte blocks, so load8 transposes them like data; the
+// round keys come out in load8's lane order and are permuted back to key order.
+SM4_TARGET("avx2,vaes") void sm4_vaes::SM4_VAES_keys(const uint8_t* keys, size_t n, uint32_t (*rkx)[32][8], uint32_t (*rkx_dec)[32][8]) {
+    const __m256i key_order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    const size_t groups = n > 8 ? 2 : 1;
+    __m256i K[2][4], Tmp[2];
+    for (size_t g = 0; g < groups; ++g) {
+        size_t m = n - 8 * g < 8 ? n - 8 * g : 8;
+        load8(keys + 128 * g, K[g], m);
+        for (int j = 0; j < 4; ++j)
+            K[g][j] = MM256_XOR2(K[g][j], _mm256_set1_epi32((int)sm4_consts::FK[j]));
+    }
+
+    for (int i = 0; i < 32; i++) {
+        __m256i ck = _mm256_set1_epi32((int)sm4_consts::CK[i]);
+        // both groups in one loop body so their S-boxes overlap
+        for (size_t g = 0; g < groups; ++g)
+            Tmp[g] = SM4_SBox(MM256_XOR4(K[g][1], K[g][2], K[g][3], ck));
+        for (size_t g = 0; g < groups; ++g) {
+            __m256i t = Tmp[g];
+            t = MM256_XOR4(K[g][0], t, MM256_ROTL_EPI32(t, 13), MM256_ROTL_EPI32(t, 23));
+            K[g][0] = K[g][1]; K[g][1] = K[g][2]; K[g][2] = K[g][3]; K[g][3] = t;
+            t = _mm256_permutevar8x32_epi32(t, key_order);
+            _mm256_storeu_si256((__m256i*)rkx[g][i], t);
+            if (rkx_dec)
+                _mm256_storeu_si256((__m256i*)rkx_dec[g][31 - i], t);
+        }
+    }
+}
+
+// T = L(tau(x)).
+// L(x) = x ^ (x <<< 24) ^ ((x ^ (x <<< 8) ^ (x <<< 16)) <<< 2), byte rotations are vpshufb
+SM4_TARGET("avx2,vaes") __m256i sm4_vaes::SM4_T(__m256i x) {
+    const __m256i r8 = _mm256_setr_epi8(
+        3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14,
+        3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14);
+    const __m256i r16 = _mm256_setr_epi8(
+        2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13,
+        2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13);
+    const __m256i r24 = _mm256_setr_epi8(
+        1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12,
+        1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12);
+
+    x = SM4_SBox(x);
+    __m256i t = MM256_XOR3(x, _mm256_shuffle_epi8(x, r8), _mm256_shuffle_epi8(x, r16));
+    return MM256_XOR3(x, _mm256_shuffle_epi8(x, r24), MM256_ROTL_EPI32(t, 2));
+}
+
+SM4_TARGET("avx2,vaes") __m256i sm4_vaes::MulMatrix(__m256i x, __m256i higherMask, __m256i lowerMask) {
+    __m256i tmp1, tmp2;
+    __m256i andMask = _mm256_set1_epi32(0x0f0f0f0f);
+    tmp2 = _mm256_srli_epi16(x, 4);
+    tmp1 = _mm256_and_si256(x, andMask);
+    tmp2 = _mm256_and_si256(tmp2, andMask);
+    tmp1 = _mm256_shuffle_epi8(lowerMask, tmp1);
+    tmp2 = _mm256_shuffle_epi8(higherMask, tmp2);
+    return _mm256_xor_si256(tmp1, tmp2);
+}
+
+// Same nibble tables as sm4_aesni, broadcast to both 128-bit lanes
+SM4_TARGET("avx2,vaes") __m256i sm4_vaes::MulMatrixATA(__m256i x) {
+    __m256i higherMask = _mm256_broadcastsi128_si256(_mm_set_epi8(
+        0x14, 0x07, (char)0xc6, (char)0xd5, 0x6c, 0x7f, (char)0xbe, (char)0xad,
+        (char)0xb9, (char)0xaa, 0x6b, 0x78, (char)0xc1, (char)0xd2, 0x13, 0x00));
+
+    __m256i lowerMask = _mm256_broadcastsi128_si256(_mm_set_epi8(
+        (char)0xd8, (char)0xb8, (char)0xfa, (char)0x9a, (char)0xc5, (char)0xa5, (char)0xe7, (char)0x87,
+        0x5f, 0x3f, 0x7d, 0x1d, 0x42, 0x22, 0x60, 0x00));
+
+    return MulMatrix(x, higherMask, lowerMask);
+}
+
+SM4_TARGET("avx2,vaes") __m256i sm4_vaes::MulMatrixTA(__m256i x) {
+    __m256i higherMask = _mm256_broadcastsi128_si256(_mm_set_epi8(
+        0x22, 0x58, 0x1a, 0x60, 0x02, 0x78, 0x3a, 0x40,
+        0x62, 0x18, 0x5a, 0x20, 0x42, 0x38, 0x7a, 0x00));
+
+    __m256i lowerMask = _mm256_broadcastsi128_si256(_mm_set_epi8(
+        (char)0xe2, 0x28, (char)0x95, 0x5f, 0x69, (char)0xa3, 0x1e, (char)0xd4,
+        0x36, (char)0xfc, 0x41, (char)0x8b, (char)0xbd, 0x77, (char)0xca, 0x00));
+
+    return MulMatrix(x, higherMask, lowerMask);
+}
+
+SM4_TARGET("avx2,vaes") __m256i sm4_vaes::SM4_SBox(__m256i x) {
+    __m256i MASK = _mm256_broadcastsi128_si256(_mm_set_epi8(
+        0x03, 0x06, 0x09, 0x0c,
+        0x0f, 0x02, 0x05, 0x08,
+        0x0b, 0x0e, 0x01, 0x04,
+        0x07, 0x0a, 0x0d, 0x00));
+    x = _mm256_shuffle_epi8(x, MASK);
+    x = _mm256_xor_si256(MulMatrixTA(x), _mm256_set1_epi8(0b00100011));
+    x = _mm256_aesenclast_epi128(x, _mm256_setzero_si256());
+    return _mm256_xor_si256(MulMatrixATA(x), _mm256_set1_epi8(0b00111011));
+}
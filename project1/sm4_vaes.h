@@ -0,0 +1,79 @@
+#pragma once
+#ifndef SM4_VAES_H
+#define SM4_VAES_H
+
+#include "sm4.h"
+#include <immintrin.h>
+
+// Note: no -m flags needed; the kernels carry target("avx2,vaes") (GCC/Clang)
+
+// 256-bit SM4: every __m256i holds one state word of 8 blocks, the S-box
+// goes through VAES (_mm256_aesenclast_epi128) with 256-bit vpshufb affine maps.
+class sm4_vaes : public sm4 {
+public:
+    sm4_vaes() = default;
+
+    // 8 blocks (128 bytes) per call
+    void encryptBlocks8(const uint8_t* plaintext, uint8_t* ciphertext) const;
+    void decryptBlocks8(const uint8_t* ciphertext, uint8_t* plaintext) const;
+
+    // 16 blocks (256 bytes) per call, two independent 8-block groups interleaved
+    void encryptBlocks16(const uint8_t* plaintext, uint8_t* ciphertext) const;
+    void decryptBlocks16(const uint8_t* ciphertext, uint8_t* plaintext) const;
+
+    // any number of blocks; a tail below 8 blocks uses masked loads/stores
+    void encryptBlocks(const uint8_t* in, uint8_t* out, size_t nblocks) const;
+    void decryptBlocks(const uint8_t* in, uint8_t* out, size_t nblocks) const;
+
+    // Multi-key batch: block i uses the 32 round keys at rks[i] (as produced by
+    // setKey/expandKey), so blocks of different sessions share the vector lanes.
+    static void encryptBlocksMultiKey(const uint32_t* const rks[], const uint8_t* in, uint8_t* out, size_t nblocks);
+    static void decryptBlocksMultiKey(const uint32_t* const rks[], const uint8_t* in, uint8_t* out, size_t nblocks);
+
+    // Pre-transposed multi-key schedule: rkx[r][j] is the round-r key of block j,
+    // n <= 8. The round order in rkx alone decides encryption vs decryption.
+    static void cryptBlocksInterleaved(const uint32_t (*rkx)[8], const uint8_t* in, uint8_t* out, size_t n);
+
+    // Batch key expansion: the 32-step schedule of 8 keys runs in the 8 lanes
+    // of a ymm register (16 keys as two interleaved groups), S-box via VAES.
+    // rkx[g] receives the [32][8] table of keys 8g..8g+7, ready for
+    // cryptBlocksInterleaved; rkx_dec, if given, the same in decryption order.
+    // Unused lanes of a final partial group hold garbage.
+    static void setKeys(const uint8_t keys[][16], size_t n, uint32_t (*rkx)[32][8], uint32_t (*rkx_dec)[32][8] = nullptr);
+
+private:
+    static void cryptBlocksMultiKey(const uint32_t* const rks[], const uint8_t* in, uint8_t* out, size_t nblocks, bool dec);
+
+    // n (1..8) blocks
+    static void SM4_VAES_do8(const uint8_t* in, uint8_t* out, const uint32_t* rk, int enc, size_t n = 8);
+    static void SM4_VAES_do16(const uint8_t* in, uint8_t* out, const uint32_t* rk, int enc);
+    // per-lane round keys, one table per 8-block group
+    static void SM4_VAES_lanes8(const uint8_t* in, uint8_t* out, const uint32_t (*rkx)[8], size_t n = 8);
+    static void SM4_VAES_lanes16(const uint8_t* in, uint8_t* out, const uint32_t (*rkx0)[8], const uint32_t (*rkx1)[8]);
+    // key schedule of 1 or 2 groups of up to 8 keys
+    static void SM4_VAES_keys(const uint8_t* keys, size_t n, uint32_t (*rkx)[32][8], uint32_t (*rkx_dec)[32][8]);
+
+    static __m256i SM4_SBox(__m256i x);
+    static __m256i SM4_T(__m256i x);
+
+#define MM256_PACK0_EPI32(a, b, c, d) \
+        _mm256_unpacklo_epi64(_mm256_unpacklo_epi32(a, b), _mm256_unpacklo_epi32(c, d))
+#define MM256_PACK1_EPI32(a, b, c, d) \
+        _mm256_unpackhi_epi64(_mm256_unpacklo_epi32(a, b), _mm256_unpacklo_epi32(c, d))
+#define MM256_PACK2_EPI32(a, b, c, d) \
+        _mm256_unpacklo_epi64(_mm256_unpackhi_epi32(a, b), _mm256_unpackhi_epi32(c, d))
+#define MM256_PACK3_EPI32(a, b, c, d) \
+        _mm256_unpackhi_epi64(_mm256_unpackhi_epi32(a, b), _mm256_unpackhi_epi32(c, d))
+
+#define MM256_XOR2(a, b) _mm256_xor_si256(a, b)
+#define MM256_XOR3(a, b, c) MM256_XOR2(a, MM256_XOR2(b, c))
+#define MM256_XOR4(a, b, c, d) MM256_XOR2(a, MM256_XOR3(b, c, d))
+#define MM256_ROTL_EPI32(a, n) \
+        MM256_XOR2(_mm256_slli_epi32(a, n), _mm256_srli_epi32(a, 32 - n))
+
+    static __m256i MulMatrix(__m256i x, __m256i higherMask, __m256i lowerMask);
+    static __m256i MulMatrixATA(__m256i x);
+    static __m256i MulMatrixTA(__m256i x);
+};
+
+#endif
@@ -1,15 +1,10 @@
 #pragma once
 
 #include "sm4.h"
-#include <immintrin.h> // AVX2
-
-//  AVX2 ģ VPROLD Ż L 任
-__m128i sm4_L_vprold(__m128i x);
 
+// ԭ VPROLD 汾ֵ L 任Ĵȱѭλrol/rorx죬
+// οʵ sm4 ȫͬΪݱ֣ SIMD  sm4_aesni/sm4_vaes/sm4_gfni
 class sm4_vprold : public sm4 {
 public:
     sm4_vprold() = default;
-
-    // дLʹAVX2ģVPROLDָ
-    uint32_t L(uint32_t x) override;
 };
@@ -0,0 +1,158 @@
+#pragma once
+#ifndef SM4_XTS_H
+#define SM4_XTS_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <emmintrin.h>
+
+// Note: SSE2 only (default on x86-64)
+
+// SM4-XTS (IEEE P1619 construction, with ciphertext stealing) over any backend
+// with setKey, const encryptBlock and const encryptBlocks/decryptBlocks.
+//
+// The 32-byte key is K1 || K2: K1 encrypts the data, K2 the tweak. A data unit
+// (sector) is at least 16 bytes; a trailing partial block is handled by
+// ciphertext stealing. Per data unit the tweak sequence T, T*a, T*a^2, ... is
+// generated with SSE2 shifts, batch blocks at a time are xored with it and
+// sent through the backend's bulk kernel in one call.
+template <class BlockCipher>
+class sm4_xts {
+public:
+    // blocks per bulk call
+    static const size_t batch = 32;
+
+    void setKey(const uint8_t key[32]) {
+        data.setKey(key);
+        tweak.setKey(key + 16);
+    }
+
+    // one data unit; iv is the 16-byte tweak value before encryption with K2
+    bool encrypt(const uint8_t iv[16], const uint8_t* in, uint8_t* out, size_t len) const {
+        return crypt<false>(iv, in, out, len);
+    }
+
+    bool decrypt(const uint8_t iv[16], const uint8_t* in, uint8_t* out, size_t len) const {
+        return crypt<true>(iv, in, out, len);
+    }
+
+    // nsectors consecutive sectors of sector_size bytes; sector s uses the
+    // data unit number sectors[s] (little-endian, as in P1619)
+    bool encryptSectors(const uint64_t* sectors, const uint8_t* in, uint8_t* out,
+        size_t sector_size, size_t nsectors) const {
+        return cryptSectors<false>(sectors, 0, in, out, sector_size, nsectors);
+    }
+
+    bool decryptSectors(const uint64_t* sectors, const uint8_t* in, uint8_t* out,
+        size_t sector_size, size_t nsectors) const {
+        return cryptSectors<true>(sectors, 0, in, out, sector_size, nsectors);
+    }
+
+    // data unit numbers first_sector, first_sector + 1, ...
+    bool encryptSectors(uint64_t first_sector, const uint8_t* in, uint8_t* out,
+        size_t sector_size, size_t nsectors) const {
+        return cryptSectors<false>(nullptr, first_sector, in, out, sector_size, nsectors);
+    }
+
+    bool decryptSectors(uint64_t first_sector, const uint8_t* in, uint8_t* out,
+        size_t sector_size, size_t nsectors) const {
+        return cryptSectors<true>(nullptr, first_sector, in, out, sector_size, nsectors);
+    }
+
+private:
+    BlockCipher data, tweak;
+
+    // T * a in GF(2^128), little-endian bit order (P1619): shift left by one,
+    // bit 127 folds back as 0x87. Each dword takes the carry of the one below.
+    static inline __m128i xts_mul_alpha(__m128i t) {
+        __m128i carry = _mm_srai_epi32(_mm_shuffle_epi32(t, 0x93), 31);
+        carry = _mm_and_si128(carry, _mm_set_epi32(1, 1, 1, 0x87));
+        return _mm_xor_si128(_mm_slli_epi32(t, 1), carry);
+    }
+
+    // n blocks (n <= batch) with tweaks t, t*a, ...; returns the next tweak
+    template <bool Dec>
+    __m128i run(__m128i t, const uint8_t* in, uint8_t* out, size_t n) const {
+        if (n == 0)
+            return t;
+        __m128i T[batch];
+        uint8_t buf[16 * batch];
+        for (size_t i = 0; i < n; ++i) {
+            T[i] = t;
+            t = xts_mul_alpha(t);
+            __m128i x = _mm_loadu_si128((const __m128i*)(in + 16 * i));
+            _mm_storeu_si128((__m128i*)(buf + 16 * i), _mm_xor_si128(x, T[i]));
+        }
+        if (Dec)
+            data.decryptBlocks(buf, buf, n);
+        else
+            data.encryptBlocks(buf, buf, n);
+        for (size_t i = 0; i < n; ++i) {
+            __m128i x = _mm_loadu_si128((const __m128i*)(buf + 16 * i));
+            _mm_storeu_si128((__m128i*)(out + 16 * i), _mm_xor_si128(x, T[i]));
+        }
+        return t;
+    }
+
+    // data unit with the already encrypted tweak t
+    template <bool Dec>
+    void unit(__m128i t, const uint8_t* in, uint8_t* out, size_t len) const {
+        size_t full = len / 16, r = len % 16;
+        // with stealing, the last full block is handled together with the tail
+        size_t bulk = r ? full - 1 : full;
+        for (size_t i = 0; i < bulk; i += batch) {
+            size_t n = bulk - i < batch ? bulk - i : batch;
+            t = run<Dec>(t, in + 16 * i, out + 16 * i, n);
+        }
+        if (r == 0)
+            return;
+
+        // Encryption: CC = E_t(P[m-1]); C[m] = CC[0..r); C[m-1] = E_ta(P[m] || CC[r..16)).
+        // Decryption uses the two tweaks in the opposite order.
+        const uint8_t* src = in + 16 * bulk;
+        uint8_t* dst = out + 16 * bulk;
+        __m128i t_next = xts_mul_alpha(t);
+        uint8_t cc[16], pp[16];
+        run<Dec>(Dec ? t_next : t, src, cc, 1);
+        std::memcpy(pp, src + 16, r);
+        std::memcpy(pp + r, cc + r, 16 - r);
+        std::memcpy(dst + 16, cc, r);
+        run<Dec>(Dec ? t : t_next, pp, dst, 1);
+    }
+
+    template <bool Dec>
+    bool crypt(const uint8_t iv[16], const uint8_t* in, uint8_t* out, size_t len) const {
+        if (len < 16)
+            return false;
+        uint8_t t[16];
+        tweak.encryptBlock(iv, t);
+        unit<Dec>(_mm_loadu_si128((const __m128i*)t), in, out, len);
+        return true;
+    }
+
+    template <bool Dec>
+    bool cryptSectors(const uint64_t* sectors, uint64_t first, const uint8_t* in, uint8_t* out,
+        size_t sector_size, size_t nsectors) const {
+        if (sector_size < 16)
+            return false;
+        // tweaks of up to batch sectors encrypted in one bulk call
+        uint8_t t[16 * batch];
+        for (size_t s = 0; s < nsectors; s += batch) {
+            size_t n = nsectors - s < batch ? nsectors - s : batch;
+            std::memset(t, 0, 16 * n);
+            for (size_t i = 0; i < n; ++i) {
+                uint64_t num = sectors ? sectors[s + i] : first + s + i;
+                for (int j = 0; j < 8; ++j)
+                    t[16 * i + j] = (uint8_t)(num >> (8 * j));
+            }
+            tweak.encryptBlocks(t, t, n);
+            for (size_t i = 0; i < n; ++i)
+                unit<Dec>(_mm_loadu_si128((const __m128i*)(t + 16 * i)),
+                    in + (s + i) * sector_size, out + (s + i) * sector_size, sector_size);
+        }
+        return true;
+    }
+};
+
+#endif
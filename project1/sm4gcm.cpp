@@ -1,18 +1,34 @@
 #include "sm4gcm.h"
 #include <cstring>
 
-sm4gcm::sm4gcm(const uint8_t key[16], const uint8_t* iv, size_t iv_len) {
+sm4gcm::sm4gcm(const uint8_t key[16]) {
     cipher.setKey(key);
 
     // H = E_k(0^128)
     uint8_t zero[16] = { 0 };
     cipher.encryptBlock(zero, H);
+}
+
+// Schedule and H come precomputed from sm4_key_cache
+sm4gcm::sm4gcm(const sm4_expanded_key& xk) {
+    cipher.setExpandedKey(xk);
+    std::memcpy(H, xk.H, 16);
+}
+
+sm4gcm::sm4gcm(const uint8_t key[16], const uint8_t* iv, size_t iv_len) : sm4gcm(key) {
+    init_j0(iv, iv_len, J0);
+}
+
+sm4gcm::sm4gcm(const sm4_expanded_key& xk, const uint8_t* iv, size_t iv_len) : sm4gcm(xk) {
+    init_j0(iv, iv_len, J0);
+}
 
+void sm4gcm::init_j0(const uint8_t* iv, size_t iv_len, uint8_t j0[16]) const {
     // J0 = IV || 0^31 || 1  if len(IV) == 96 bits
     // Else: J0 = GHASH(IV || pad || len(IV)*8)
     if (iv_len == 12) {
-        std::memcpy(J0, iv, 12);
-        J0[12] = 0x00; J0[13] = 0x00; J0[14] = 0x00; J0[15] = 0x01;
+        std::memcpy(j0, iv, 12);
+        j0[12] = 0x00; j0[13] = 0x00; j0[14] = 0x00; j0[15] = 0x01;
     }
     else {
         uint8_t S[16] = { 0 };
@@ -43,46 +59,77 @@ sm4gcm::sm4gcm(const uint8_t key[16], const uint8_t* iv, size_t iv_len) {
         xor_block(S, len_block);
         gmul(S, H);
 
-        std::memcpy(J0, S, 16);
+        std::memcpy(j0, S, 16);
     }
+}
 
-    std::memcpy(counter, J0, 16);
+void sm4gcm::seal(const uint8_t* iv, size_t iv_len,
+    const uint8_t* plaintext, size_t len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext, uint8_t tag[16]) const {
+    uint8_t j0[16];
+    init_j0(iv, iv_len, j0);
+    seal_j0(j0, plaintext, len, aad, aad_len, ciphertext, tag);
+}
+
+bool sm4gcm::open(const uint8_t* iv, size_t iv_len,
+    const uint8_t* ciphertext, size_t len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t tag[16], uint8_t* plaintext) const {
+    uint8_t j0[16];
+    init_j0(iv, iv_len, j0);
+    return open_j0(j0, ciphertext, len, aad, aad_len, tag, plaintext);
 }
 
 void sm4gcm::encrypt(const uint8_t* plaintext, size_t len,
     const uint8_t* aad, size_t aad_len,
     uint8_t* ciphertext, uint8_t tag[16]) {
-    std::memcpy(counter, J0, 16);
-    inc32(counter);
+    seal_j0(J0, plaintext, len, aad, aad_len, ciphertext, tag);
+}
 
-    encrypt_ctr(plaintext, len, ciphertext);
+bool sm4gcm::decrypt(const uint8_t* ciphertext, size_t len,
+    const uint8_t* aad, size_t aad_len,
+    const uint8_t tag[16], uint8_t* plaintext) {
+    return open_j0(J0, ciphertext, len, aad, aad_len, tag, plaintext);
+}
+
+void sm4gcm::seal_j0(const uint8_t j0[16], const uint8_t* plaintext, size_t len,
+    const uint8_t* aad, size_t aad_len,
+    uint8_t* ciphertext, uint8_t tag[16]) const {
+    encrypt_ctr(j0, plaintext, len, ciphertext);
     ghash(aad, aad_len, ciphertext, len, tag);
 
     uint8_t Ek0[16];
-    cipher.encryptBlock(J0, Ek0);
+    cipher.encryptBlock(j0, Ek0);
     xor_block(tag, Ek0);
 }
 
-bool sm4gcm::decrypt(const uint8_t* ciphertext, size_t len,
+bool sm4gcm::open_j0(const uint8_t j0[16], const uint8_t* ciphertext, size_t len,
     const uint8_t* aad, size_t aad_len,
-    const uint8_t tag[16], uint8_t* plaintext) {
-    std::memcpy(counter, J0, 16);
-    inc32(counter);
-
-    encrypt_ctr(ciphertext, len, plaintext);
-
+    const uint8_t tag[16], uint8_t* plaintext) const {
     uint8_t computed_tag[16];
     ghash(aad, aad_len, ciphertext, len, computed_tag);
 
     uint8_t Ek0[16];
-    cipher.encryptBlock(J0, Ek0);
+    cipher.encryptBlock(j0, Ek0);
     xor_block(computed_tag, Ek0);
 
-    return std::memcmp(computed_tag, tag, 16) == 0;
+    // constant-time compare; decrypt only an authentic message
+    uint8_t diff = 0;
+    for (int i = 0; i < 16; ++i)
+        diff |= computed_tag[i] ^ tag[i];
+    if (diff)
+        return false;
+
+    encrypt_ctr(j0, ciphertext, len, plaintext);
+    return true;
 }
 
-void sm4gcm::encrypt_ctr(const uint8_t* input, size_t len, uint8_t* output) {
-    uint8_t keystream[16];
+// counter blocks start at inc32(J0)
+void sm4gcm::encrypt_ctr(const uint8_t j0[16], const uint8_t* input, size_t len, uint8_t* output) const {
+    uint8_t counter[16], keystream[16];
+    std::memcpy(counter, j0, 16);
+    inc32(counter);
     for (size_t i = 0; i < len; i += 16) {
         cipher.encryptBlock(counter, keystream);
         size_t block_size = (i + 16 <= len) ? 16 : (len - i);
@@ -94,7 +141,7 @@ void sm4gcm::encrypt_ctr(const uint8_t* input, size_t len, uint8_t* output) {
 
 void sm4gcm::ghash(const uint8_t* aad, size_t aad_len,
     const uint8_t* ct, size_t ct_len,
-    uint8_t tag[16]) {
+    uint8_t tag[16]) const {
     uint8_t Y[16] = { 0 };
 
     // GHASH AAD
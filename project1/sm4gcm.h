@@ -4,10 +4,29 @@
 #include <cstddef>
 #include "sm4.h"
 
+// Key-only constructors plus seal()/open() take the nonce per message: the key
+// schedule and H are computed once and the const calls can be shared between
+// threads. The IV constructors with encrypt()/decrypt() remain for one-shot use.
+// open()/decrypt() check the tag over the ciphertext first and run the
+// keystream pass only when it matches; on failure plaintext is not written.
 class sm4gcm {
 public:
+    explicit sm4gcm(const uint8_t key[16]);
+    explicit sm4gcm(const sm4_expanded_key& xk);
     sm4gcm(const uint8_t key[16], const uint8_t* iv, size_t iv_len);
+    sm4gcm(const sm4_expanded_key& xk, const uint8_t* iv, size_t iv_len);
 
+    void seal(const uint8_t* iv, size_t iv_len,
+        const uint8_t* plaintext, size_t len,
+        const uint8_t* aad, size_t aad_len,
+        uint8_t* ciphertext, uint8_t tag[16]) const;
+
+    bool open(const uint8_t* iv, size_t iv_len,
+        const uint8_t* ciphertext, size_t len,
+        const uint8_t* aad, size_t aad_len,
+        const uint8_t tag[16], uint8_t* plaintext) const;
+
+    // use the IV given to the constructor
     void encrypt(const uint8_t* plaintext, size_t len,
         const uint8_t* aad, size_t aad_len,
         uint8_t* ciphertext, uint8_t tag[16]);
@@ -18,16 +37,22 @@ public:
 
 private:
     sm4 cipher;
-    uint8_t H[16];    // Hash subkey
-    uint8_t J0[16];   // Pre-counter block
-    uint8_t counter[16]; // Current counter
+    uint8_t H[16];         // Hash subkey
+    uint8_t J0[16] = {};   // Pre-counter block of the constructor IV
 
+    void init_j0(const uint8_t* iv, size_t iv_len, uint8_t j0[16]) const;
+    void seal_j0(const uint8_t j0[16], const uint8_t* plaintext, size_t len,
+        const uint8_t* aad, size_t aad_len,
+        uint8_t* ciphertext, uint8_t tag[16]) const;
+    bool open_j0(const uint8_t j0[16], const uint8_t* ciphertext, size_t len,
+        const uint8_t* aad, size_t aad_len,
+        const uint8_t tag[16], uint8_t* plaintext) const;
     void ghash(const uint8_t* aad, size_t aad_len,
         const uint8_t* ct, size_t ct_len,
-        uint8_t tag[16]);
+        uint8_t tag[16]) const;
 
-    void gmul(uint8_t X[16], const uint8_t Y[16]);
-    void xor_block(uint8_t out[16], const uint8_t in[16]);
-    void inc32(uint8_t block[16]);
-    void encrypt_ctr(const uint8_t* input, size_t len, uint8_t* output);
+    static void gmul(uint8_t X[16], const uint8_t Y[16]);
+    static void xor_block(uint8_t out[16], const uint8_t in[16]);
+    static void inc32(uint8_t block[16]);
+    void encrypt_ctr(const uint8_t j0[16], const uint8_t* input, size_t len, uint8_t* output) const;
 };